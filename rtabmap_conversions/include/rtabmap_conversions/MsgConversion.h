@@ -81,6 +81,8 @@ rtabmap::SensorData rgbdImageFromROS(const rtabmap_msgs::RGBDImageConstPtr & ima
 // copy data
 void compressedMatToBytes(const cv::Mat & compressed, std::vector<unsigned char> & bytes);
 cv::Mat compressedMatFromBytes(const std::vector<unsigned char> & bytes, bool copy = true);
+// share data: the returned cv::Mat references bytes and keeps trackedObject (its owner) alive
+cv::Mat compressedMatFromBytes(const std::vector<unsigned char> & bytes, const boost::shared_ptr<void const> & trackedObject);
 
 void infoFromROS(const rtabmap_msgs::Info & info, rtabmap::Statistics & stat);
 void infoToROS(const rtabmap::Statistics & stats, rtabmap_msgs::Info & info);
@@ -119,9 +121,23 @@ std::vector<cv::Point3f> points3fFromROS(const std::vector<rtabmap_msgs::Point3f
 void points3fFromROS(const std::vector<rtabmap_msgs::Point3f> & msg, std::vector<cv::Point3f> & points3, const rtabmap::Transform & transform = rtabmap::Transform());
 void points3fToROS(const std::vector<cv::Point3f> & pts, std::vector<rtabmap_msgs::Point3f> & msg, const rtabmap::Transform & transform = rtabmap::Transform());
 
+// Packed features (PACKED_LAYOUT_V1): cv::KeyPoint and cv::Point3f arrays are copied with memcpy
+void keypointsToROS(const std::vector<cv::KeyPoint> & kpts, std::vector<unsigned char> & packed);
+void keypointsFromROS(const std::vector<unsigned char> & packed, std::vector<cv::KeyPoint> & kpts, int xShift=0);
+void points3fToROS(const std::vector<cv::Point3f> & pts, std::vector<float> & packed, const rtabmap::Transform & transform = rtabmap::Transform());
+void points3fFromROS(const std::vector<float> & packed, std::vector<cv::Point3f> & points3, const rtabmap::Transform & transform = rtabmap::Transform());
+// Zero-copy views of packed features, valid as long as the message is:
+//  keypoints: Nx7 CV_32FC1 (octave and class_id columns are int32)
+//  points: Nx1 CV_32FC3
+cv::Mat keypointsMatFromROS(const std::vector<unsigned char> & packed);
+cv::Mat points3fMatFromROS(const std::vector<float> & packed);
+
+// Models are cached by CameraInfo calibration content. Set
+// initRectification to also compute (once) the rectification maps.
 rtabmap::CameraModel cameraModelFromROS(
 		const sensor_msgs::CameraInfo & camInfo,
-		const rtabmap::Transform & localTransform = rtabmap::Transform::getIdentity());
+		const rtabmap::Transform & localTransform = rtabmap::Transform::getIdentity(),
+		bool initRectification = false);
 void cameraModelToROS(
 		const rtabmap::CameraModel & model,
 		sensor_msgs::CameraInfo & camInfo);
@@ -130,26 +146,31 @@ rtabmap::StereoCameraModel stereoCameraModelFromROS(
 		const sensor_msgs::CameraInfo & leftCamInfo,
 		const sensor_msgs::CameraInfo & rightCamInfo,
 		const rtabmap::Transform & localTransform = rtabmap::Transform::getIdentity(),
-		const rtabmap::Transform & stereoTransform = rtabmap::Transform());
+		const rtabmap::Transform & stereoTransform = rtabmap::Transform(),
+		bool initRectification = false);
 rtabmap::StereoCameraModel stereoCameraModelFromROS(
 		const sensor_msgs::CameraInfo & leftCamInfo,
 		const sensor_msgs::CameraInfo & rightCamInfo,
 		const std::string & frameId,
-		tf::TransformListener & listener,
-		double waitForTransform);
+		tf::Transformer & listener,
+		double waitForTransform,
+		bool initRectification = false);
 
 void mapDataFromROS(
 		const rtabmap_msgs::MapData & msg,
 		std::map<int, rtabmap::Transform> & poses,
 		std::multimap<int, rtabmap::Link> & links,
 		std::map<int, rtabmap::Signature> & signatures,
-		rtabmap::Transform & mapToOdom);
+		rtabmap::Transform & mapToOdom,
+		int threads = 0);
 void mapDataToROS(
 		const std::map<int, rtabmap::Transform> & poses,
 		const std::multimap<int, rtabmap::Link> & links,
 		const std::map<int, rtabmap::Signature> & signatures,
 		const rtabmap::Transform & mapToOdom,
-		rtabmap_msgs::MapData & msg);
+		rtabmap_msgs::MapData & msg,
+		bool packedFeatures = false,
+		int threads = 0);
 
 void mapGraphFromROS(
 		const rtabmap_msgs::MapGraph & msg,
@@ -163,10 +184,25 @@ void mapGraphToROS(
 		rtabmap_msgs::MapGraph & msg);
 
 rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorData & msg);
-void sensorDataToROS(const rtabmap::SensorData & signature, rtabmap_msgs::SensorData & msg, const std::string & frameId = "base_link", bool copyRawData = false);
+// Compressed data (images, scan, user data, grids) reference the message
+// buffers instead of being copied, the message is kept alive with them.
+rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorDataConstPtr & msg);
+void sensorDataToROS(const rtabmap::SensorData & signature, rtabmap_msgs::SensorData & msg, const std::string & frameId = "base_link", bool copyRawData = false, bool packedFeatures = false);
 
 rtabmap::Signature nodeFromROS(const rtabmap_msgs::Node & msg);
-void nodeToROS(const rtabmap::Signature & signature, rtabmap_msgs::Node & msg);
+void nodeToROS(const rtabmap::Signature & signature, rtabmap_msgs::Node & msg, bool packedFeatures = false);
+
+// Convert nodes in parallel (threads<=0: hardware concurrency).
+// If indices are set, only these nodes are converted (in the same order).
+std::vector<rtabmap::Signature> nodesFromROS(
+		const std::vector<rtabmap_msgs::Node> & msgs,
+		const std::vector<int> & indices = std::vector<int>(),
+		int threads = 0);
+void nodesToROS(
+		const std::map<int, rtabmap::Signature> & signatures,
+		std::vector<rtabmap_msgs::Node> & msgs,
+		bool packedFeatures = false,
+		int threads = 0);
 
 // DEPRECATED
 rtabmap::Signature nodeDataFromROS(const rtabmap_msgs::Node & msg);
@@ -177,7 +213,19 @@ void nodeInfoToROS(const rtabmap::Signature & signature, rtabmap_msgs::Node & ms
 
 std::map<std::string, float> odomInfoToStatistics(const rtabmap::OdometryInfo & info);
 rtabmap::OdometryInfo odomInfoFromROS(const rtabmap_msgs::OdomInfo & msg, bool ignoreData = false);
-void odomInfoToROS(const rtabmap::OdometryInfo & info, rtabmap_msgs::OdomInfo & msg, bool ignoreData = false);
+void odomInfoToROS(const rtabmap::OdometryInfo & info, rtabmap_msgs::OdomInfo & msg, bool ignoreData = false, bool packedFeatures = false);
+// Data fields of OdomInfo (statistics and transforms are always converted)
+enum OdomInfoFields {
+	kOdomInfoWords = 1,         // wordsKeys, wordsValues
+	kOdomInfoWordMatches = 2,   // wordMatches, wordInliers
+	kOdomInfoCorners = 4,       // refCorners, newCorners, cornerInliers
+	kOdomInfoLocalMap = 8,      // localMapKeys, localMapValues
+	kOdomInfoLocalScanMap = 16, // localScanMap
+	kOdomInfoLocalBundle = 32,  // localBundleIds, localBundlePoses, localBundleModels
+	kOdomInfoAll = 63
+};
+// Only fields set in the mask (see OdomInfoFields) are converted.
+void odomInfoToROS(const rtabmap::OdometryInfo & info, rtabmap_msgs::OdomInfo & msg, int fields, bool packedFeatures);
 
 cv::Mat userDataFromROS(const rtabmap_msgs::UserData & dataMsg);
 void userDataToROS(const cv::Mat & data, rtabmap_msgs::UserData & dataMsg, bool compress);
@@ -190,7 +238,7 @@ rtabmap::Landmarks landmarksFromROS(
 		const std::string & frameId,
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		double defaultLinVariance,
 		double defaultAngVariance);
@@ -202,7 +250,7 @@ rtabmap::Transform getTransform(
 		const std::string & fromFrameId,
 		const std::string & toFrameId,
 		const ros::Time & stamp,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform);
 
 
@@ -213,7 +261,7 @@ rtabmap::Transform getMovingTransform(
 		const std::string & fixedFrame,
 		const ros::Time & stampFrom,
 		const ros::Time & stampTo,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform);
 
 bool convertRGBDMsgs(
@@ -228,7 +276,7 @@ bool convertRGBDMsgs(
 		cv::Mat & depth,
 		std::vector<rtabmap::CameraModel> & cameraModels,
 		std::vector<rtabmap::StereoCameraModel> & stereoCameraModels,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool alreadRectifiedImages,
 		const std::vector<std::vector<rtabmap_msgs::KeyPoint> > & localKeyPointsMsgs = std::vector<std::vector<rtabmap_msgs::KeyPoint> >(),
@@ -249,17 +297,27 @@ bool convertStereoMsg(
 		cv::Mat & left,
 		cv::Mat & right,
 		rtabmap::StereoCameraModel & stereoModel,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool alreadyRectified);
 
+// Project ranges of the scan (x,y[,z][,intensity] with invalid ranges
+// removed) using a cached table of beam directions. If motion (pose of the
+// laser at the end of the scan relative to scan stamp) is set, points are
+// deskewed by interpolating it along beams. transform is applied after.
+cv::Mat laserScanToPoints(
+		const sensor_msgs::LaserScan & msg,
+		bool is2D = true,
+		const rtabmap::Transform & motion = rtabmap::Transform(),
+		const rtabmap::Transform & transform = rtabmap::Transform());
+
 bool convertScanMsg(
 		const sensor_msgs::LaserScan & scan2dMsg,
 		const std::string & frameId,
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
 		rtabmap::LaserScan & scan,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool outputInFrameId = false);
 
@@ -269,17 +327,28 @@ bool convertScan3dMsg(
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
 		rtabmap::LaserScan & scan,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		int maxPoints = 0,
 		float maxRange = 0.0f,
+		bool is2D = false,
+		float minRange = 0.0f);
+
+// Convert directly from the raw buffer (common XYZ, XYZI, XYZRGB, normals,
+// time layouts), filtering invalid points and points outside [minRange, maxRange].
+rtabmap::LaserScan laserScanFromROS(
+		const sensor_msgs::PointCloud2 & msg,
+		const rtabmap::Transform & localTransform = rtabmap::Transform::getIdentity(),
+		int maxPoints = 0,
+		float maxRange = 0.0f,
+		float minRange = 0.0f,
 		bool is2D = false);
 
 bool deskew(
 		const sensor_msgs::PointCloud2 & input,
 		sensor_msgs::PointCloud2 & output,
 		const std::string & fixedFrameId,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool slerp = false);
 
@@ -289,6 +358,16 @@ bool deskew(
 		double previousStamp,
 		const rtabmap::Transform & velocity);
 
+// Deskew using a buffer of IMU measurements (stamp, imu with base->imu
+// local transform). localTransform is base->input frame. Only the linear
+// part of velocity (base frame, per second), e.g., from odometry, is used.
+bool deskew(
+		const sensor_msgs::PointCloud2 & input,
+		sensor_msgs::PointCloud2 & output,
+		const std::map<double, rtabmap::IMU> & imus,
+		const rtabmap::Transform & localTransform,
+		const rtabmap::Transform & velocity = rtabmap::Transform());
+
 }
 
 #endif /* MSGCONVERSION_H_ */
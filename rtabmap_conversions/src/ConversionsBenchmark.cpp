@@ -0,0 +1,509 @@
+/*
+Copyright (c) 2010-2024, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Benchmarks of the conversions used on odometry/SLAM hot paths, with
+// synthetic inputs. Conversions needing TF (convert*Msg, TF deskewing) use a
+// prefilled tf::Transformer, so no ROS master is required. Example:
+//   rosrun rtabmap_conversions rtabmap_conversions_bench --benchmark_filter=Scan
+
+#include <benchmark/benchmark.h>
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <tf/tf.h>
+#include <rtabmap_conversions/MsgConversion.h>
+#include <rtabmap/core/OdometryInfo.h>
+#include <rtabmap/core/Signature.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const std::string kFrameId = "base_link";
+const std::string kOdomFrameId = "odom";
+const std::string kCameraFrameId = "camera_link";
+const std::string kLaserFrameId = "laser_link";
+const ros::Time kStamp(1700000000, 0);
+
+// TF tree odom -> base_link -> {camera_link, laser_link} filled at 100 Hz
+// around kStamp, base_link moving at 1 m/s and 0.5 rad/s
+tf::Transformer & transformer()
+{
+	static tf::Transformer tfBuffer(true, ros::Duration(10.0));
+	static bool filled = false;
+	if(!filled)
+	{
+		tf::Transform cameraT;
+		tf::Transform laserT;
+		rtabmap_conversions::transformToTF(rtabmap::Transform(0.1f, 0, 0.3f, -M_PI/2, 0, -M_PI/2), cameraT);
+		rtabmap_conversions::transformToTF(rtabmap::Transform(0.2f, 0, 0.2f, 0, 0, 0), laserT);
+		for(int i=-50; i<=50; ++i)
+		{
+			double dt = double(i)*0.01;
+			ros::Time stamp = kStamp + ros::Duration(dt);
+			tf::Transform odomT;
+			rtabmap_conversions::transformToTF(rtabmap::Transform(dt, 0, 0, 0, 0, 0.5*dt), odomT);
+			tfBuffer.setTransform(tf::StampedTransform(odomT, stamp, kOdomFrameId, kFrameId));
+			tfBuffer.setTransform(tf::StampedTransform(cameraT, stamp, kFrameId, kCameraFrameId));
+			tfBuffer.setTransform(tf::StampedTransform(laserT, stamp, kFrameId, kLaserFrameId));
+		}
+		filled = true;
+	}
+	return tfBuffer;
+}
+
+template<typename T>
+size_t messageSize(const T & msg)
+{
+	return ros::serialization::serializationLength(msg);
+}
+
+void setBytes(benchmark::State & state, size_t bytes)
+{
+	state.SetBytesProcessed(int64_t(state.iterations()) * bytes);
+	state.counters["bytes/op"] = bytes;
+}
+
+sensor_msgs::CameraInfo makeCameraInfo(int width, int height, double tx = 0.0)
+{
+	sensor_msgs::CameraInfo info;
+	info.header.frame_id = kCameraFrameId;
+	info.header.stamp = kStamp;
+	info.width = width;
+	info.height = height;
+	info.distortion_model = "plumb_bob";
+	info.D.resize(5, 0.0);
+	double f = 525.0 * double(width) / 640.0;
+	info.K = {f, 0, width/2.0, 0, f, height/2.0, 0, 0, 1};
+	info.R = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+	info.P = {f, 0, width/2.0, tx, 0, f, height/2.0, 0, 0, 0, 1, 0};
+	return info;
+}
+
+cv_bridge::CvImageConstPtr makeImage(int width, int height, int type, const std::string & encoding)
+{
+	cv_bridge::CvImagePtr image(new cv_bridge::CvImage);
+	image->header.frame_id = kCameraFrameId;
+	image->header.stamp = kStamp;
+	image->encoding = encoding;
+	image->image = cv::Mat(height, width, type);
+	if(type == CV_16UC1)
+	{
+		cv::randu(image->image, 500, 5000);
+	}
+	else
+	{
+		cv::randu(image->image, 0, 255);
+	}
+	return image;
+}
+
+// Organized cloud with Ouster-like layout: x,y,z,intensity (float32),
+// t (uint32, ns since scan stamp), ring (uint16), 10% invalid points
+sensor_msgs::PointCloud2 makeOrganizedCloud(int rings, int columns)
+{
+	sensor_msgs::PointCloud2 cloud;
+	cloud.header.frame_id = kLaserFrameId;
+	cloud.header.stamp = kStamp;
+	sensor_msgs::PointCloud2Modifier modifier(cloud);
+	modifier.setPointCloud2Fields(6,
+			"x", 1, sensor_msgs::PointField::FLOAT32,
+			"y", 1, sensor_msgs::PointField::FLOAT32,
+			"z", 1, sensor_msgs::PointField::FLOAT32,
+			"intensity", 1, sensor_msgs::PointField::FLOAT32,
+			"t", 1, sensor_msgs::PointField::UINT32,
+			"ring", 1, sensor_msgs::PointField::UINT16);
+	modifier.resize(rings*columns);
+	cloud.height = rings;
+	cloud.width = columns;
+	cloud.row_step = columns*cloud.point_step;
+	cloud.is_dense = false;
+
+	sensor_msgs::PointCloud2Iterator<float> iterX(cloud, "x");
+	sensor_msgs::PointCloud2Iterator<float> iterI(cloud, "intensity");
+	sensor_msgs::PointCloud2Iterator<uint32_t> iterT(cloud, "t");
+	sensor_msgs::PointCloud2Iterator<uint16_t> iterR(cloud, "ring");
+	for(int r=0; r<rings; ++r)
+	{
+		float elevation = (float(r)/float(rings) - 0.5f) * 45.0f * M_PI / 180.0f;
+		for(int c=0; c<columns; ++c, ++iterX, ++iterI, ++iterT, ++iterR)
+		{
+			float azimuth = float(c)/float(columns) * 2.0f * M_PI;
+			float range = (r*columns+c) % 10 == 0?NAN:5.0f + float((r*7+c*13)%450)/10.0f;
+			iterX[0] = range * cos(elevation) * cos(azimuth);
+			iterX[1] = range * cos(elevation) * sin(azimuth);
+			iterX[2] = range * sin(elevation);
+			*iterI = float((r+c)%255);
+			*iterT = uint32_t(double(c)/double(columns) * 100000000.0); // 10 Hz
+			*iterR = r;
+		}
+	}
+	return cloud;
+}
+
+sensor_msgs::LaserScan makeLaserScan(int beams)
+{
+	sensor_msgs::LaserScan scan;
+	scan.header.frame_id = kLaserFrameId;
+	scan.header.stamp = kStamp;
+	scan.angle_min = -M_PI;
+	scan.angle_increment = 2.0*M_PI/double(beams);
+	scan.angle_max = scan.angle_min + scan.angle_increment*(beams-1);
+	scan.time_increment = 0.1/double(beams);
+	scan.scan_time = 0.1;
+	scan.range_min = 0.1;
+	scan.range_max = 30.0;
+	scan.ranges.resize(beams);
+	scan.intensities.resize(beams);
+	for(int i=0; i<beams; ++i)
+	{
+		scan.ranges[i] = i%20==0?std::numeric_limits<float>::infinity():1.0f + float(i%290)/10.0f;
+		scan.intensities[i] = i%255;
+	}
+	return scan;
+}
+
+void makeFeatures(int count, int width, int height, std::vector<cv::KeyPoint> & kpts, std::vector<cv::Point3f> & pts, cv::Mat & descriptors)
+{
+	kpts.resize(count);
+	pts.resize(count);
+	for(int i=0; i<count; ++i)
+	{
+		kpts[i] = cv::KeyPoint(float((i*37)%width), float((i*53)%height), 31.0f, float(i%360), 0.001f*i, i%8, -1);
+		pts[i] = cv::Point3f(0.1f*(i%50), 0.05f*(i%30), 1.0f + 0.01f*i);
+	}
+	descriptors = cv::Mat(count, 32, CV_8UC1);
+	cv::randu(descriptors, 0, 255);
+}
+
+rtabmap::SensorData makeSensorData(int width, int height, int features)
+{
+	rtabmap::SensorData data(
+			makeImage(width, height, CV_8UC3, sensor_msgs::image_encodings::BGR8)->image,
+			makeImage(width, height, CV_16UC1, sensor_msgs::image_encodings::TYPE_16UC1)->image,
+			rtabmap_conversions::cameraModelFromROS(makeCameraInfo(width, height)),
+			1,
+			kStamp.toSec());
+	std::vector<cv::KeyPoint> kpts;
+	std::vector<cv::Point3f> pts;
+	cv::Mat descriptors;
+	makeFeatures(features, width, height, kpts, pts, descriptors);
+	data.setFeatures(kpts, pts, descriptors);
+	return data;
+}
+
+// Graph of nodes with poses, neighbor links and visual words (no images)
+void makeGraph(
+		int nodes,
+		int words,
+		std::map<int, rtabmap::Transform> & poses,
+		std::multimap<int, rtabmap::Link> & links,
+		std::map<int, rtabmap::Signature> & signatures)
+{
+	cv::Mat information = cv::Mat::eye(6,6,CV_64FC1)*100.0;
+	for(int id=1; id<=nodes; ++id)
+	{
+		rtabmap::Transform pose(0.5f*id, 0.1f*(id%10), 0, 0, 0, 0.01f*id);
+		poses.insert(std::make_pair(id, pose));
+		if(id>1)
+		{
+			links.insert(std::make_pair(id-1, rtabmap::Link(id-1, id, rtabmap::Link::kNeighbor, poses.at(id-1).inverse()*pose, information)));
+		}
+		std::vector<cv::KeyPoint> kpts;
+		std::vector<cv::Point3f> pts;
+		cv::Mat descriptors;
+		makeFeatures(words, 640, 480, kpts, pts, descriptors);
+		std::multimap<int, int> wordIds;
+		for(int i=0; i<words; ++i)
+		{
+			wordIds.insert(wordIds.end(), std::make_pair(id*words+i, i));
+		}
+		rtabmap::Signature s(id, 0, 0, kStamp.toSec()+id, "", pose);
+		s.setWords(wordIds, kpts, pts, descriptors);
+		signatures.insert(std::make_pair(id, s));
+	}
+}
+
+} // namespace
+
+static void BM_ConvertRGBDMsgs(benchmark::State & state)
+{
+	int width = state.range(0);
+	int height = state.range(1);
+	std::vector<cv_bridge::CvImageConstPtr> images(1, makeImage(width, height, CV_8UC3, sensor_msgs::image_encodings::BGR8));
+	std::vector<cv_bridge::CvImageConstPtr> depths(1, makeImage(width, height, CV_16UC1, sensor_msgs::image_encodings::TYPE_16UC1));
+	std::vector<sensor_msgs::CameraInfo> infos(1, makeCameraInfo(width, height));
+	std::vector<sensor_msgs::CameraInfo> depthInfos(1, makeCameraInfo(width, height));
+	for(auto _ : state)
+	{
+		cv::Mat rgb, depth;
+		std::vector<rtabmap::CameraModel> models;
+		std::vector<rtabmap::StereoCameraModel> stereoModels;
+		benchmark::DoNotOptimize(rtabmap_conversions::convertRGBDMsgs(
+				images, depths, infos, depthInfos, kFrameId, kOdomFrameId, kStamp-ros::Duration(0.05),
+				rgb, depth, models, stereoModels, transformer(), 0.0, true));
+	}
+	setBytes(state, images[0]->image.total()*images[0]->image.elemSize() + depths[0]->image.total()*depths[0]->image.elemSize());
+}
+BENCHMARK(BM_ConvertRGBDMsgs)->Args({640, 480})->Args({1280, 720});
+
+static void BM_ConvertStereoMsg(benchmark::State & state)
+{
+	int width = state.range(0);
+	int height = state.range(1);
+	cv_bridge::CvImageConstPtr left = makeImage(width, height, CV_8UC1, sensor_msgs::image_encodings::MONO8);
+	cv_bridge::CvImageConstPtr right = makeImage(width, height, CV_8UC1, sensor_msgs::image_encodings::MONO8);
+	sensor_msgs::CameraInfo leftInfo = makeCameraInfo(width, height);
+	sensor_msgs::CameraInfo rightInfo = makeCameraInfo(width, height, -leftInfo.P[0]*0.05);
+	for(auto _ : state)
+	{
+		cv::Mat leftOut, rightOut;
+		rtabmap::StereoCameraModel model;
+		benchmark::DoNotOptimize(rtabmap_conversions::convertStereoMsg(
+				left, right, leftInfo, rightInfo, kFrameId, kOdomFrameId, kStamp-ros::Duration(0.05),
+				leftOut, rightOut, model, transformer(), 0.0, true));
+	}
+	setBytes(state, left->image.total()*2);
+}
+BENCHMARK(BM_ConvertStereoMsg)->Args({640, 480})->Args({1280, 720});
+
+static void BM_RgbdImageFromROS(benchmark::State & state)
+{
+	int width = state.range(0);
+	int height = state.range(1);
+	rtabmap_msgs::RGBDImagePtr msg(new rtabmap_msgs::RGBDImage);
+	msg->header.frame_id = kFrameId;
+	msg->header.stamp = kStamp;
+	makeImage(width, height, CV_8UC3, sensor_msgs::image_encodings::BGR8)->toImageMsg(msg->rgb);
+	makeImage(width, height, CV_16UC1, sensor_msgs::image_encodings::TYPE_16UC1)->toImageMsg(msg->depth);
+	msg->rgb_camera_info = makeCameraInfo(width, height);
+	msg->depth_camera_info = makeCameraInfo(width, height);
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(rtabmap_conversions::rgbdImageFromROS(msg));
+	}
+	setBytes(state, messageSize(*msg));
+}
+BENCHMARK(BM_RgbdImageFromROS)->Args({640, 480})->Args({1280, 720});
+
+static void BM_CameraModelFromROS(benchmark::State & state)
+{
+	sensor_msgs::CameraInfo info = makeCameraInfo(640, 480);
+	rtabmap::Transform localTransform(0, 0, 0, -M_PI/2, 0, -M_PI/2);
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(rtabmap_conversions::cameraModelFromROS(info, localTransform));
+	}
+}
+BENCHMARK(BM_CameraModelFromROS);
+
+static void BM_ConvertScanMsg(benchmark::State & state)
+{
+	sensor_msgs::LaserScan msg = makeLaserScan(state.range(0));
+	for(auto _ : state)
+	{
+		rtabmap::LaserScan scan;
+		benchmark::DoNotOptimize(rtabmap_conversions::convertScanMsg(msg, kFrameId, kOdomFrameId, kStamp-ros::Duration(0.05), scan, transformer(), 0.0));
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_ConvertScanMsg)->Arg(720)->Arg(1440);
+
+static void BM_LaserScanToPoints(benchmark::State & state)
+{
+	sensor_msgs::LaserScan msg = makeLaserScan(state.range(0));
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(rtabmap_conversions::laserScanToPoints(msg));
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_LaserScanToPoints)->Arg(720)->Arg(1440);
+
+static void BM_ConvertScan3dMsg(benchmark::State & state)
+{
+	sensor_msgs::PointCloud2 msg = makeOrganizedCloud(state.range(0), 1024);
+	for(auto _ : state)
+	{
+		rtabmap::LaserScan scan;
+		benchmark::DoNotOptimize(rtabmap_conversions::convertScan3dMsg(msg, kFrameId, kOdomFrameId, kStamp-ros::Duration(0.05), scan, transformer(), 0.0));
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_ConvertScan3dMsg)->Arg(64)->Arg(128);
+
+static void BM_LaserScanFromROS(benchmark::State & state)
+{
+	sensor_msgs::PointCloud2 msg = makeOrganizedCloud(state.range(0), 1024);
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(rtabmap_conversions::laserScanFromROS(msg));
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_LaserScanFromROS)->Arg(64)->Arg(128);
+
+static void BM_DeskewConstantVelocity(benchmark::State & state)
+{
+	sensor_msgs::PointCloud2 msg = makeOrganizedCloud(state.range(0), 1024);
+	rtabmap::Transform velocity(1.0f, 0, 0, 0, 0, 0.5f);
+	for(auto _ : state)
+	{
+		sensor_msgs::PointCloud2 output;
+		benchmark::DoNotOptimize(rtabmap_conversions::deskew(msg, output, kStamp.toSec()-0.1, velocity));
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_DeskewConstantVelocity)->Arg(64)->Arg(128);
+
+// args: rings, slerp (0: one TF lookup per column)
+static void BM_DeskewTF(benchmark::State & state)
+{
+	sensor_msgs::PointCloud2 msg = makeOrganizedCloud(state.range(0), 1024);
+	tf::Transformer & tfBuffer = transformer();
+	for(auto _ : state)
+	{
+		sensor_msgs::PointCloud2 output;
+		benchmark::DoNotOptimize(rtabmap_conversions::deskew(msg, output, kOdomFrameId, tfBuffer, 0.0, state.range(1)!=0));
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_DeskewTF)->Args({64, 0})->Args({64, 1})->Args({128, 0})->Args({128, 1});
+
+// args: width, height, packed features
+static void BM_SensorDataToROS(benchmark::State & state)
+{
+	rtabmap::SensorData data = makeSensorData(state.range(0), state.range(1), 1000);
+	rtabmap_msgs::SensorData msg;
+	for(auto _ : state)
+	{
+		msg = rtabmap_msgs::SensorData();
+		rtabmap_conversions::sensorDataToROS(data, msg, kFrameId, true, state.range(2)!=0);
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_SensorDataToROS)->Args({640, 480, 0})->Args({640, 480, 1})->Args({1280, 720, 0})->Args({1280, 720, 1});
+
+static void BM_SensorDataFromROS(benchmark::State & state)
+{
+	rtabmap::SensorData data = makeSensorData(state.range(0), state.range(1), 1000);
+	rtabmap_msgs::SensorData msg;
+	rtabmap_conversions::sensorDataToROS(data, msg, kFrameId, true, state.range(2)!=0);
+	for(auto _ : state)
+	{
+		benchmark::DoNotOptimize(rtabmap_conversions::sensorDataFromROS(msg));
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_SensorDataFromROS)->Args({640, 480, 0})->Args({640, 480, 1})->Args({1280, 720, 0})->Args({1280, 720, 1});
+
+// args: nodes, packed features, threads
+static void BM_MapDataToROS(benchmark::State & state)
+{
+	std::map<int, rtabmap::Transform> poses;
+	std::multimap<int, rtabmap::Link> links;
+	std::map<int, rtabmap::Signature> signatures;
+	makeGraph(state.range(0), 100, poses, links, signatures);
+	rtabmap_msgs::MapData msg;
+	for(auto _ : state)
+	{
+		msg = rtabmap_msgs::MapData();
+		rtabmap_conversions::mapDataToROS(poses, links, signatures, rtabmap::Transform::getIdentity(), msg, state.range(1)!=0, state.range(2));
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_MapDataToROS)->Args({10000, 0, 1})->Args({10000, 1, 1})->Args({10000, 1, 0})->Unit(benchmark::kMillisecond);
+
+static void BM_MapDataFromROS(benchmark::State & state)
+{
+	std::map<int, rtabmap::Transform> poses;
+	std::multimap<int, rtabmap::Link> links;
+	std::map<int, rtabmap::Signature> signatures;
+	makeGraph(state.range(0), 100, poses, links, signatures);
+	rtabmap_msgs::MapData msg;
+	rtabmap_conversions::mapDataToROS(poses, links, signatures, rtabmap::Transform::getIdentity(), msg, state.range(1)!=0);
+	for(auto _ : state)
+	{
+		std::map<int, rtabmap::Transform> posesOut;
+		std::multimap<int, rtabmap::Link> linksOut;
+		std::map<int, rtabmap::Signature> signaturesOut;
+		rtabmap::Transform mapToOdom;
+		rtabmap_conversions::mapDataFromROS(msg, posesOut, linksOut, signaturesOut, mapToOdom, state.range(2));
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_MapDataFromROS)->Args({10000, 0, 1})->Args({10000, 1, 1})->Args({10000, 1, 0})->Unit(benchmark::kMillisecond);
+
+// args: words, packed features
+static void BM_OdomInfoToROS(benchmark::State & state)
+{
+	int words = state.range(0);
+	rtabmap::OdometryInfo info;
+	info.features = words;
+	info.localMapSize = words*5;
+	info.transform = rtabmap::Transform(0.1f, 0, 0, 0, 0, 0.01f);
+	for(int i=0; i<words; ++i)
+	{
+		info.words.insert(std::make_pair(i, cv::KeyPoint(float(i%640), float(i%480), 31.0f)));
+		info.reg.matchesIDs.push_back(i);
+		if(i%2==0)
+		{
+			info.reg.inliersIDs.push_back(i);
+		}
+	}
+	for(int i=0; i<words*5; ++i)
+	{
+		info.localMap.insert(std::make_pair(i, cv::Point3f(0.01f*i, 0.5f, 2.0f)));
+	}
+	rtabmap_msgs::OdomInfo msg;
+	for(auto _ : state)
+	{
+		msg = rtabmap_msgs::OdomInfo();
+		rtabmap_conversions::odomInfoToROS(info, msg, false, state.range(1)!=0);
+	}
+	setBytes(state, messageSize(msg));
+}
+BENCHMARK(BM_OdomInfoToROS)->Args({1000, 0})->Args({1000, 1});
+
+int main(int argc, char ** argv)
+{
+	ros::init(argc, argv, "rtabmap_conversions_bench", ros::init_options::AnonymousName | ros::init_options::NoSigintHandler);
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+	// wall time, the node is never started
+	ros::Time::init();
+
+	benchmark::Initialize(&argc, argv);
+	if(benchmark::ReportUnrecognizedArguments(argc, argv))
+	{
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	return 0;
+}
@@ -37,6 +37,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/ULogger.h>
 #include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <pcl_conversions/pcl_conversions.h>
 #include <eigen_conversions/eigen_msg.h>
 #include <tf_conversions/tf_eigen.h>
@@ -436,8 +440,8 @@ void compressedMatToBytes(const cv::Mat & compressed, std::vector<unsigned char>
 	bytes.clear();
 	if(!compressed.empty())
 	{
-		bytes.resize(compressed.cols * compressed.rows);
-		memcpy(bytes.data(), compressed.data, bytes.size());
+		UASSERT(compressed.isContinuous());
+		bytes.assign(compressed.data, compressed.data + compressed.cols * compressed.rows);
 	}
 }
 
@@ -455,6 +459,79 @@ cv::Mat compressedMatFromBytes(const std::vector<unsigned char> & bytes, bool co
 	return out;
 }
 
+namespace {
+// Allocator used once to wrap an existing buffer in a cv::Mat: the buffer's
+// owner is kept alive until the last cv::Mat referencing it is released.
+class TrackedBufferAllocator : public cv::MatAllocator
+{
+public:
+	TrackedBufferAllocator(const boost::shared_ptr<void const> & trackedObject, const unsigned char * data, size_t size) :
+		trackedObject_(trackedObject),
+		data_((unsigned char *)data),
+		size_(size)
+	{}
+	virtual ~TrackedBufferAllocator() {}
+
+#if CV_MAJOR_VERSION > 3
+	virtual cv::UMatData* allocate(int dims, const int* sizes, int type, void*, size_t* step, cv::AccessFlag, cv::UMatUsageFlags) const
+#else
+	virtual cv::UMatData* allocate(int dims, const int* sizes, int type, void*, size_t* step, int, cv::UMatUsageFlags) const
+#endif
+	{
+		size_t total = CV_ELEM_SIZE(type);
+		for(int i=dims-1; i>=0; --i)
+		{
+			if(step)
+			{
+				step[i] = total;
+			}
+			total *= sizes[i];
+		}
+		UASSERT(total == size_);
+		cv::UMatData* u = new cv::UMatData(this);
+		u->data = u->origdata = data_;
+		u->size = total;
+		return u;
+	}
+#if CV_MAJOR_VERSION > 3
+	virtual bool allocate(cv::UMatData*, cv::AccessFlag, cv::UMatUsageFlags) const
+#else
+	virtual bool allocate(cv::UMatData*, int, cv::UMatUsageFlags) const
+#endif
+	{
+		return false;
+	}
+	virtual void deallocate(cv::UMatData* u) const
+	{
+		delete u;
+		// one allocator per buffer, release the tracked object with it
+		delete this;
+	}
+
+private:
+	boost::shared_ptr<void const> trackedObject_;
+	unsigned char * data_;
+	size_t size_;
+};
+}
+
+cv::Mat compressedMatFromBytes(const std::vector<unsigned char> & bytes, const boost::shared_ptr<void const> & trackedObject)
+{
+	if(!trackedObject.get())
+	{
+		return compressedMatFromBytes(bytes, true);
+	}
+	cv::Mat out;
+	if(bytes.size())
+	{
+		out.allocator = new TrackedBufferAllocator(trackedObject, bytes.data(), bytes.size());
+		out.create(1, bytes.size(), CV_8UC1);
+		// the buffer keeps a reference on its allocator, not needed anymore in the header
+		out.allocator = 0;
+	}
+	return out;
+}
+
 void infoFromROS(const rtabmap_msgs::Info & info, rtabmap::Statistics & stat)
 {
 	stat.setExtended(true); // Extended
@@ -792,7 +869,149 @@ void points3fToROS(const std::vector<cv::Point3f> & pts, std::vector<rtabmap_msg
 	}
 }
 
-rtabmap::CameraModel cameraModelFromROS(
+void keypointsToROS(const std::vector<cv::KeyPoint> & kpts, std::vector<unsigned char> & packed)
+{
+	static_assert(sizeof(cv::KeyPoint) == 7*sizeof(float), "cv::KeyPoint layout doesn't match PACKED_LAYOUT_V1");
+	packed.resize(kpts.size()*sizeof(cv::KeyPoint));
+	if(!kpts.empty())
+	{
+		memcpy(packed.data(), kpts.data(), packed.size());
+	}
+}
+
+void keypointsFromROS(const std::vector<unsigned char> & packed, std::vector<cv::KeyPoint> & kpts, int xShift)
+{
+	UASSERT(packed.size() % sizeof(cv::KeyPoint) == 0);
+	size_t outCurrentIndex = kpts.size();
+	size_t size = packed.size()/sizeof(cv::KeyPoint);
+	kpts.resize(kpts.size()+size);
+	if(size)
+	{
+		memcpy(&kpts[outCurrentIndex], packed.data(), packed.size());
+	}
+	if(xShift != 0)
+	{
+		for(size_t i=outCurrentIndex; i<kpts.size(); ++i)
+		{
+			kpts[i].pt.x += xShift;
+		}
+	}
+}
+
+void points3fToROS(const std::vector<cv::Point3f> & pts, std::vector<float> & packed, const rtabmap::Transform & transform)
+{
+	packed.resize(pts.size()*3);
+	if(pts.empty())
+	{
+		return;
+	}
+	if(!transform.isNull() && !transform.isIdentity())
+	{
+		for(size_t i=0; i<pts.size(); ++i)
+		{
+			cv::Point3f pt = rtabmap::util3d::transformPoint(pts[i], transform);
+			packed[i*3] = pt.x;
+			packed[i*3+1] = pt.y;
+			packed[i*3+2] = pt.z;
+		}
+	}
+	else
+	{
+		memcpy(packed.data(), pts.data(), packed.size()*sizeof(float));
+	}
+}
+
+void points3fFromROS(const std::vector<float> & packed, std::vector<cv::Point3f> & points3, const rtabmap::Transform & transform)
+{
+	UASSERT(packed.size() % 3 == 0);
+	size_t currentIndex = points3.size();
+	points3.resize(points3.size()+packed.size()/3);
+	if(packed.empty())
+	{
+		return;
+	}
+	memcpy(&points3[currentIndex], packed.data(), packed.size()*sizeof(float));
+	if(!transform.isNull() && !transform.isIdentity())
+	{
+		for(size_t i=currentIndex; i<points3.size(); ++i)
+		{
+			points3[i] = rtabmap::util3d::transformPoint(points3[i], transform);
+		}
+	}
+}
+
+cv::Mat keypointsMatFromROS(const std::vector<unsigned char> & packed)
+{
+	UASSERT(packed.size() % sizeof(cv::KeyPoint) == 0);
+	if(packed.empty())
+	{
+		return cv::Mat();
+	}
+	return cv::Mat(packed.size()/sizeof(cv::KeyPoint), 7, CV_32FC1, (void*)packed.data());
+}
+
+cv::Mat points3fMatFromROS(const std::vector<float> & packed)
+{
+	UASSERT(packed.size() % 3 == 0);
+	if(packed.empty())
+	{
+		return cv::Mat();
+	}
+	return cv::Mat(packed.size()/3, 1, CV_32FC3, (void*)packed.data());
+}
+
+namespace {
+// Calibration content of a CameraInfo, compared entirely on lookup
+struct CameraInfoKey
+{
+	CameraInfoKey(const sensor_msgs::CameraInfo & camInfo) :
+		width(camInfo.width),
+		height(camInfo.height),
+		distortionModel(camInfo.distortion_model),
+		D(camInfo.D)
+	{
+		std::copy(camInfo.K.begin(), camInfo.K.end(), K);
+		std::copy(camInfo.R.begin(), camInfo.R.end(), R);
+		std::copy(camInfo.P.begin(), camInfo.P.end(), P);
+	}
+	unsigned int width;
+	unsigned int height;
+	std::string distortionModel;
+	std::vector<double> D;
+	double K[9];
+	double R[9];
+	double P[12];
+
+	bool operator<(const CameraInfoKey & k) const
+	{
+		if(width != k.width) return width < k.width;
+		if(height != k.height) return height < k.height;
+		int c = memcmp(K, k.K, sizeof(K));
+		if(c != 0) return c < 0;
+		c = memcmp(P, k.P, sizeof(P));
+		if(c != 0) return c < 0;
+		c = memcmp(R, k.R, sizeof(R));
+		if(c != 0) return c < 0;
+		if(D.size() != k.D.size()) return D.size() < k.D.size();
+		if(!D.empty())
+		{
+			// bitwise, so that NaN values compare consistently
+			c = memcmp(D.data(), k.D.data(), D.size()*sizeof(double));
+			if(c != 0) return c < 0;
+		}
+		return distortionModel < k.distortionModel;
+	}
+};
+
+// Models are cached by calibration content only, so that matrices are
+// parsed and rectification maps computed only once per camera. The local
+// transform (which can change every frame) is set on the returned copy.
+// cv::Mat being reference counted, returned copies share the cached data.
+UMutex g_cameraModelsMutex;
+std::map<CameraInfoKey, rtabmap::CameraModel> g_cameraModels;
+const size_t kCameraModelsCacheSize = 64;
+
+rtabmap::CameraModel parseCameraModel(
 		const sensor_msgs::CameraInfo & camInfo,
 		const rtabmap::Transform & localTransform)
 {
@@ -866,6 +1085,43 @@ rtabmap::CameraModel cameraModelFromROS(
 			K, D, R, P,
 			localTransform);
 }
+
+// Returns the cached model, the local transform of the returned model
+// should be set by the caller.
+rtabmap::CameraModel cameraModelFromROSImpl(
+		const sensor_msgs::CameraInfo & camInfo,
+		const rtabmap::Transform & localTransform,
+		bool initRectification)
+{
+	CameraInfoKey key(camInfo);
+	UScopeMutex lock(g_cameraModelsMutex);
+	std::map<CameraInfoKey, rtabmap::CameraModel>::iterator iter = g_cameraModels.find(key);
+	if(iter == g_cameraModels.end())
+	{
+		if(g_cameraModels.size() >= kCameraModelsCacheSize)
+		{
+			// calibration changing continuously (e.g., zoom), don't grow forever
+			g_cameraModels.clear();
+		}
+		iter = g_cameraModels.insert(std::make_pair(key, parseCameraModel(camInfo, localTransform))).first;
+	}
+	if(initRectification && !iter->second.isRectificationMapInitialized() && iter->second.isValidForRectification())
+	{
+		iter->second.initRectificationMap();
+	}
+	return iter->second;
+}
+}
+
+rtabmap::CameraModel cameraModelFromROS(
+		const sensor_msgs::CameraInfo & camInfo,
+		const rtabmap::Transform & localTransform,
+		bool initRectification)
+{
+	rtabmap::CameraModel model = cameraModelFromROSImpl(camInfo, localTransform, initRectification);
+	model.setLocalTransform(localTransform);
+	return model;
+}
 void cameraModelToROS(
 		const rtabmap::CameraModel & model,
 		sensor_msgs::CameraInfo & camInfo)
@@ -935,20 +1191,24 @@ rtabmap::StereoCameraModel stereoCameraModelFromROS(
 		const sensor_msgs::CameraInfo & leftCamInfo,
 		const sensor_msgs::CameraInfo & rightCamInfo,
 		const rtabmap::Transform & localTransform,
-		const rtabmap::Transform & stereoTransform)
+		const rtabmap::Transform & stereoTransform,
+		bool initRectification)
 {
-	return rtabmap::StereoCameraModel(
-			"ros",
-			cameraModelFromROS(leftCamInfo, localTransform),
-			cameraModelFromROS(rightCamInfo, localTransform),
-			stereoTransform);
+	// left and right models are cached separately with their rectification
+	// maps, the stereo model itself is cheap to build
+	rtabmap::CameraModel left = cameraModelFromROSImpl(leftCamInfo, localTransform, initRectification);
+	rtabmap::CameraModel right = cameraModelFromROSImpl(rightCamInfo, localTransform, initRectification);
+	left.setLocalTransform(localTransform);
+	right.setLocalTransform(localTransform);
+	return rtabmap::StereoCameraModel("ros", left, right, stereoTransform);
 }
 rtabmap::StereoCameraModel stereoCameraModelFromROS(
 		const sensor_msgs::CameraInfo & leftCamInfo,
 		const sensor_msgs::CameraInfo & rightCamInfo,
 		const std::string & frameId,
-		tf::TransformListener & listener,
-		double waitForTransform)
+		tf::Transformer & listener,
+		double waitForTransform,
+		bool initRectification)
 {
 	rtabmap::Transform localTransform = getTransform(
 			frameId,
@@ -971,7 +1231,7 @@ rtabmap::StereoCameraModel stereoCameraModelFromROS(
 	{
 		return rtabmap::StereoCameraModel();
 	}
-	return stereoCameraModelFromROS(leftCamInfo, rightCamInfo, localTransform, stereoTransform);
+	return stereoCameraModelFromROS(leftCamInfo, rightCamInfo, localTransform, stereoTransform, initRectification);
 }
 
 void mapDataFromROS(
@@ -979,15 +1239,17 @@ void mapDataFromROS(
 		std::map<int, rtabmap::Transform> & poses,
 		std::multimap<int, rtabmap::Link> & links,
 		std::map<int, rtabmap::Signature> & signatures,
-		rtabmap::Transform & mapToOdom)
+		rtabmap::Transform & mapToOdom,
+		int threads)
 {
 	//optimized graph
 	mapGraphFromROS(msg.graph, poses, links, mapToOdom);
 
 	//Data
-	for(unsigned int i=0; i<msg.nodes.size(); ++i)
+	std::vector<rtabmap::Signature> nodes = nodesFromROS(msg.nodes, std::vector<int>(), threads);
+	for(unsigned int i=0; i<nodes.size(); ++i)
 	{
-		signatures.insert(std::make_pair(msg.nodes[i].id, nodeFromROS(msg.nodes[i])));
+		signatures.insert(std::make_pair(msg.nodes[i].id, nodes[i]));
 	}
 }
 void mapDataToROS(
@@ -995,20 +1257,15 @@ void mapDataToROS(
 		const std::multimap<int, rtabmap::Link> & links,
 		const std::map<int, rtabmap::Signature> & signatures,
 		const rtabmap::Transform & mapToOdom,
-		rtabmap_msgs::MapData & msg)
+		rtabmap_msgs::MapData & msg,
+		bool packedFeatures,
+		int threads)
 {
 	//Optimized graph
 	mapGraphToROS(poses, links, mapToOdom, msg.graph);
 
 	//Data
-	msg.nodes.resize(signatures.size());
-	int index=0;
-	for(std::multimap<int, rtabmap::Signature>::const_iterator iter = signatures.begin();
-		iter!=signatures.end();
-		++iter)
-	{
-		nodeToROS(iter->second, msg.nodes[index++]);
-	}
+	nodesToROS(signatures, msg.nodes, packedFeatures, threads);
 }
 
 void mapGraphFromROS(
@@ -1061,13 +1318,14 @@ void mapGraphToROS(
 	transformToGeometryMsg(mapToOdom, msg.mapToOdom);
 }
 
-rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorData & msg)
+namespace {
+rtabmap::SensorData sensorDataFromROSImpl(const rtabmap_msgs::SensorData & msg, const boost::shared_ptr<void const> & trackedMsg)
 {
 	rtabmap::SensorData s(
 			cv::Mat(),
 			msg.header.seq,
 			msg.header.stamp.toSec(),
-			compressedMatFromBytes(msg.user_data));
+			compressedMatFromBytes(msg.user_data, trackedMsg));
 
 	std::vector<rtabmap::StereoCameraModel> stereoModels;
 	std::vector<rtabmap::CameraModel> models;
@@ -1176,8 +1434,8 @@ rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorData & msg)
 	if(isStereo)
 	{
 		s.setStereoImage(
-			compressedMatFromBytes(msg.left_compressed),
-			compressedMatFromBytes(msg.right_compressed),
+			compressedMatFromBytes(msg.left_compressed, trackedMsg),
+			compressedMatFromBytes(msg.right_compressed, trackedMsg),
 			stereoModels);
 		if(!left.empty() && !right.empty())
 		{
@@ -1187,8 +1445,8 @@ rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorData & msg)
 	else
 	{
 		s.setRGBDImage(
-			compressedMatFromBytes(msg.left_compressed),
-			compressedMatFromBytes(msg.right_compressed),
+			compressedMatFromBytes(msg.left_compressed, trackedMsg),
+			compressedMatFromBytes(msg.right_compressed, trackedMsg),
 			models);
 		if(!left.empty() && !right.empty())
 		{
@@ -1200,7 +1458,7 @@ rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorData & msg)
 	if(!msg.laser_scan_compressed.empty())
 	{
 		s.setLaserScan(rtabmap::LaserScan(
-			compressedMatFromBytes(msg.laser_scan_compressed),
+			compressedMatFromBytes(msg.laser_scan_compressed, trackedMsg),
 			msg.laser_scan_max_pts,
 			msg.laser_scan_max_range,
 			(rtabmap::LaserScan::Format)msg.laser_scan_format,
@@ -1223,13 +1481,21 @@ rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorData & msg)
 	std::vector<cv::KeyPoint> keypoints;
 	std::vector<cv::Point3f> keypoints3D;
 	cv::Mat descriptors;
-	if(!msg.key_points.empty())
+	if(msg.packed_layout == rtabmap_msgs::SensorData::PACKED_LAYOUT_V1)
 	{
-		keypoints = rtabmap_conversions::keypointsFromROS(msg.key_points);
+		rtabmap_conversions::keypointsFromROS(msg.key_points_packed, keypoints);
+		rtabmap_conversions::points3fFromROS(msg.points_packed, keypoints3D);
 	}
-	if(!msg.points.empty())
+	else
 	{
-		keypoints3D = rtabmap_conversions::points3fFromROS(msg.points);
+		if(!msg.key_points.empty())
+		{
+			keypoints = rtabmap_conversions::keypointsFromROS(msg.key_points);
+		}
+		if(!msg.points.empty())
+		{
+			keypoints3D = rtabmap_conversions::points3fFromROS(msg.points);
+		}
 	}
 	if(!msg.descriptors.empty())
 	{
@@ -1240,16 +1506,28 @@ rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorData & msg)
 	s.setGlobalDescriptors(rtabmap_conversions::globalDescriptorsFromROS(msg.global_descriptors));
 	s.setEnvSensors(rtabmap_conversions::envSensorsFromROS(msg.env_sensors));
 	s.setOccupancyGrid(
-			compressedMatFromBytes(msg.grid_ground),
-			compressedMatFromBytes(msg.grid_obstacles),
-			compressedMatFromBytes(msg.grid_empty_cells),
+			compressedMatFromBytes(msg.grid_ground, trackedMsg),
+			compressedMatFromBytes(msg.grid_obstacles, trackedMsg),
+			compressedMatFromBytes(msg.grid_empty_cells, trackedMsg),
 			msg.grid_cell_size,
 			point3fFromROS(msg.grid_view_point));
 	s.setGPS(rtabmap::GPS(msg.gps.stamp, msg.gps.longitude, msg.gps.latitude, msg.gps.altitude, msg.gps.error, msg.gps.bearing));
 	s.setIMU(rtabmap_conversions::imuFromROS(msg.imu, transformFromGeometryMsg(msg.imu_local_transform)));
 	return s;
 }
-void sensorDataToROS(const rtabmap::SensorData & data, rtabmap_msgs::SensorData & msg, const std::string & frameId, bool copyRawData)
+}
+
+rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorData & msg)
+{
+	return sensorDataFromROSImpl(msg, boost::shared_ptr<void const>());
+}
+
+rtabmap::SensorData sensorDataFromROS(const rtabmap_msgs::SensorDataConstPtr & msg)
+{
+	UASSERT(msg.get());
+	return sensorDataFromROSImpl(*msg, msg);
+}
+void sensorDataToROS(const rtabmap::SensorData & data, rtabmap_msgs::SensorData & msg, const std::string & frameId, bool copyRawData, bool packedFeatures)
 {
 	// add data
 	msg.header.seq = data.id();
@@ -1373,13 +1651,22 @@ void sensorDataToROS(const rtabmap::SensorData & data, rtabmap_msgs::SensorData
 	msg.grid_cell_size = data.gridCellSize();
 
 	//convert features
-	if(!data.keypoints().empty())
+	if(packedFeatures)
 	{
-		rtabmap_conversions::keypointsToROS(data.keypoints(), msg.key_points);
+		msg.packed_layout = rtabmap_msgs::SensorData::PACKED_LAYOUT_V1;
+		rtabmap_conversions::keypointsToROS(data.keypoints(), msg.key_points_packed);
+		rtabmap_conversions::points3fToROS(data.keypoints3D(), msg.points_packed);
 	}
-	if(!data.keypoints3D().empty())
+	else
 	{
-		rtabmap_conversions::points3fToROS(data.keypoints3D(), msg.points);
+		if(!data.keypoints().empty())
+		{
+			rtabmap_conversions::keypointsToROS(data.keypoints(), msg.key_points);
+		}
+		if(!data.keypoints3D().empty())
+		{
+			rtabmap_conversions::points3fToROS(data.keypoints3D(), msg.points);
+		}
 	}
 	if(!data.descriptors().empty())
 	{
@@ -1405,6 +1692,22 @@ rtabmap::Signature nodeFromROS(const rtabmap_msgs::Node & msg)
 
 	cv::Mat wordsDescriptors = rtabmap::uncompressData(msg.word_descriptors);
 
+	if(msg.packed_layout == rtabmap_msgs::Node::PACKED_LAYOUT_V1)
+	{
+		keypointsFromROS(msg.word_kpts_packed, wordsKpts);
+		points3fFromROS(msg.word_pts_packed, words3D);
+		if(!wordsKpts.empty() && wordsKpts.size() != msg.word_id_keys.size())
+		{
+			ROS_ERROR("Word IDs and 2D keypoints should be the same size (%d, %d)!", (int)msg.word_id_keys.size(), (int)wordsKpts.size());
+			wordsKpts.clear();
+		}
+		if(!words3D.empty() && words3D.size() != msg.word_id_keys.size())
+		{
+			ROS_ERROR("Word IDs and 3D points should be the same size (%d, %d)!", (int)msg.word_id_keys.size(), (int)words3D.size());
+			words3D.clear();
+		}
+	}
+
 	if(msg.word_id_keys.size() != msg.word_id_values.size())
 	{
 		ROS_ERROR("Word ID keys and values should be the same size (%d, %d)!", (int)msg.word_id_keys.size(), (int)msg.word_id_values.size());
@@ -1460,7 +1763,7 @@ rtabmap::Signature nodeFromROS(const rtabmap_msgs::Node & msg)
 	s.sensorData().setId(msg.id);
 	return s;
 }
-void nodeToROS(const rtabmap::Signature & signature, rtabmap_msgs::Node & msg)
+void nodeToROS(const rtabmap::Signature & signature, rtabmap_msgs::Node & msg, bool packedFeatures)
 {
 	// add data
 	msg.id = signature.id();
@@ -1495,7 +1798,7 @@ void nodeToROS(const rtabmap::Signature & signature, rtabmap_msgs::Node & msg)
 	{
 		msg.word_id_keys.at(i) = iter->first;
 		msg.word_id_values.at(i) = iter->second;
-		if(signature.getWordsKpts().size() == signature.getWords().size())
+		if(!packedFeatures && signature.getWordsKpts().size() == signature.getWords().size())
 		{
 			if(msg.word_kpts.empty())
 			{
@@ -1503,7 +1806,7 @@ void nodeToROS(const rtabmap::Signature & signature, rtabmap_msgs::Node & msg)
 			}
 			keypointToROS(signature.getWordsKpts().at(i), msg.word_kpts.at(i));
 		}
-		if(signature.getWords3().size() == signature.getWords().size())
+		if(!packedFeatures && signature.getWords3().size() == signature.getWords().size())
 		{
 			if(msg.word_pts.empty())
 			{
@@ -1513,6 +1816,18 @@ void nodeToROS(const rtabmap::Signature & signature, rtabmap_msgs::Node & msg)
 		}
 		++i;
 	}
+	if(packedFeatures)
+	{
+		msg.packed_layout = rtabmap_msgs::Node::PACKED_LAYOUT_V1;
+		if(signature.getWordsKpts().size() == signature.getWords().size())
+		{
+			keypointsToROS(signature.getWordsKpts(), msg.word_kpts_packed);
+		}
+		if(signature.getWords3().size() == signature.getWords().size())
+		{
+			points3fToROS(signature.getWords3(), msg.word_pts_packed);
+		}
+	}
 
 	if(!signature.getWordsDescriptors().empty())
 	{
@@ -1528,10 +1843,78 @@ void nodeToROS(const rtabmap::Signature & signature, rtabmap_msgs::Node & msg)
 		}
 	}
 
-	sensorDataToROS(signature.sensorData(), msg.data);
+	sensorDataToROS(signature.sensorData(), msg.data, "base_link", false, packedFeatures);
 	transformToPoseMsg(signature.getGroundTruthPose(), msg.data.ground_truth_pose);
 }
 
+namespace {
+void parallelForWorker(int thread, int threads, size_t size, const boost::function<void(size_t)> & f)
+{
+	// interleaved so that big and small nodes are spread between threads
+	for(size_t i=thread; i<size; i+=threads)
+	{
+		f(i);
+	}
+}
+void parallelFor(size_t size, int threads, const boost::function<void(size_t)> & f)
+{
+	if(threads <= 0)
+	{
+		threads = std::max(1, (int)boost::thread::hardware_concurrency());
+	}
+	threads = std::min(threads, (int)size);
+	if(threads <= 1)
+	{
+		for(size_t i=0; i<size; ++i)
+		{
+			f(i);
+		}
+		return;
+	}
+	boost::thread_group workers;
+	for(int t=1; t<threads; ++t)
+	{
+		workers.create_thread(boost::bind(&parallelForWorker, t, threads, size, boost::cref(f)));
+	}
+	parallelForWorker(0, threads, size, f);
+	workers.join_all();
+}
+void nodeFromROSAt(const std::vector<rtabmap_msgs::Node> & msgs, const std::vector<int> & indices, std::vector<rtabmap::Signature> & signatures, size_t i)
+{
+	signatures[i] = nodeFromROS(msgs[indices.empty()?i:indices[i]]);
+}
+void nodeToROSAt(const std::vector<const rtabmap::Signature*> & signatures, std::vector<rtabmap_msgs::Node> & msgs, bool packedFeatures, size_t i)
+{
+	nodeToROS(*signatures[i], msgs[i], packedFeatures);
+}
+} // namespace
+
+std::vector<rtabmap::Signature> nodesFromROS(
+		const std::vector<rtabmap_msgs::Node> & msgs,
+		const std::vector<int> & indices,
+		int threads)
+{
+	std::vector<rtabmap::Signature> signatures(indices.empty()?msgs.size():indices.size());
+	parallelFor(signatures.size(), threads, boost::bind(&nodeFromROSAt, boost::cref(msgs), boost::cref(indices), boost::ref(signatures), _1));
+	return signatures;
+}
+
+void nodesToROS(
+		const std::map<int, rtabmap::Signature> & signatures,
+		std::vector<rtabmap_msgs::Node> & msgs,
+		bool packedFeatures,
+		int threads)
+{
+	std::vector<const rtabmap::Signature*> signaturesPtr;
+	signaturesPtr.reserve(signatures.size());
+	for(std::map<int, rtabmap::Signature>::const_iterator iter = signatures.begin(); iter!=signatures.end(); ++iter)
+	{
+		signaturesPtr.push_back(&iter->second);
+	}
+	msgs.resize(signaturesPtr.size());
+	parallelFor(signaturesPtr.size(), threads, boost::bind(&nodeToROSAt, boost::cref(signaturesPtr), boost::ref(msgs), packedFeatures, _1));
+}
+
 rtabmap::Signature nodeDataFromROS(const rtabmap_msgs::Node & msg)
 {
 	return nodeFromROS(msg);
@@ -1703,10 +2086,23 @@ rtabmap::OdometryInfo odomInfoFromROS(const rtabmap_msgs::OdomInfo & msg, bool i
 
 	if(!ignoreData)
 	{
-		UASSERT(msg.wordsKeys.size() == msg.wordsValues.size());
-		for(unsigned int i=0; i<msg.wordsKeys.size(); ++i)
+		if(msg.packedLayout == rtabmap_msgs::OdomInfo::PACKED_LAYOUT_V1)
 		{
-			info.words.insert(std::make_pair(msg.wordsKeys[i], keypointFromROS(msg.wordsValues[i])));
+			std::vector<cv::KeyPoint> kpts;
+			keypointsFromROS(msg.wordsValuesPacked, kpts);
+			UASSERT(msg.wordsKeys.size() == kpts.size());
+			for(unsigned int i=0; i<msg.wordsKeys.size(); ++i)
+			{
+				info.words.insert(info.words.end(), std::make_pair(msg.wordsKeys[i], kpts[i]));
+			}
+		}
+		else
+		{
+			UASSERT(msg.wordsKeys.size() == msg.wordsValues.size());
+			for(unsigned int i=0; i<msg.wordsKeys.size(); ++i)
+			{
+				info.words.insert(std::make_pair(msg.wordsKeys[i], keypointFromROS(msg.wordsValues[i])));
+			}
 		}
 
 		info.refCorners = points2fFromROS(msg.refCorners);
@@ -1718,10 +2114,23 @@ rtabmap::OdometryInfo odomInfoFromROS(const rtabmap_msgs::OdomInfo & msg, bool i
 		info.transformGroundTruth = transformFromGeometryMsg(msg.transformGroundTruth);
 		info.guess = transformFromGeometryMsg(msg.guess);
 
-		UASSERT(msg.localMapKeys.size() == msg.localMapValues.size());
-		for(unsigned int i=0; i<msg.localMapKeys.size(); ++i)
+		if(msg.packedLayout == rtabmap_msgs::OdomInfo::PACKED_LAYOUT_V1)
+		{
+			std::vector<cv::Point3f> points;
+			points3fFromROS(msg.localMapValuesPacked, points);
+			UASSERT(msg.localMapKeys.size() == points.size());
+			for(unsigned int i=0; i<msg.localMapKeys.size(); ++i)
+			{
+				info.localMap.insert(info.localMap.end(), std::make_pair(msg.localMapKeys[i], points[i]));
+			}
+		}
+		else
 		{
-			info.localMap.insert(std::make_pair(msg.localMapKeys[i], point3fFromROS(msg.localMapValues[i])));
+			UASSERT(msg.localMapKeys.size() == msg.localMapValues.size());
+			for(unsigned int i=0; i<msg.localMapKeys.size(); ++i)
+			{
+				info.localMap.insert(std::make_pair(msg.localMapKeys[i], point3fFromROS(msg.localMapValues[i])));
+			}
 		}
 
 		pcl::PCLPointCloud2 cloud;
@@ -1731,7 +2140,12 @@ rtabmap::OdometryInfo odomInfoFromROS(const rtabmap_msgs::OdomInfo & msg, bool i
 	return info;
 }
 
-void odomInfoToROS(const rtabmap::OdometryInfo & info, rtabmap_msgs::OdomInfo & msg, bool ignoreData)
+void odomInfoToROS(const rtabmap::OdometryInfo & info, rtabmap_msgs::OdomInfo & msg, bool ignoreData, bool packedFeatures)
+{
+	odomInfoToROS(info, msg, ignoreData?(int)kOdomInfoLocalBundle:(int)kOdomInfoAll, packedFeatures);
+}
+
+void odomInfoToROS(const rtabmap::OdometryInfo & info, rtabmap_msgs::OdomInfo & msg, int fields, bool packedFeatures)
 {
 	msg.lost = info.lost;
 	msg.matches = info.reg.matches;
@@ -1755,7 +2169,7 @@ void odomInfoToROS(const rtabmap::OdometryInfo & info, rtabmap_msgs::OdomInfo &
 	msg.localBundleTime = info.localBundleTime;
 	UASSERT(info.localBundleModels.size() == info.localBundlePoses.size());
 	for(std::map<int, std::vector<rtabmap::CameraModel> >::const_iterator iter=info.localBundleModels.begin();
-		iter!=info.localBundleModels.end();
+		(fields & kOdomInfoLocalBundle) && iter!=info.localBundleModels.end();
 		++iter)
 	{
 		msg.localBundleIds.push_back(iter->first);
@@ -1792,21 +2206,52 @@ void odomInfoToROS(const rtabmap::OdometryInfo & info, rtabmap_msgs::OdomInfo &
 	transformToGeometryMsg(info.transformGroundTruth, msg.transformGroundTruth);
 	transformToGeometryMsg(info.guess, msg.guess);
 
-	if(!ignoreData)
+	if(packedFeatures && (fields & (kOdomInfoWords | kOdomInfoLocalMap)))
+	{
+		msg.packedLayout = rtabmap_msgs::OdomInfo::PACKED_LAYOUT_V1;
+	}
+
+	if(fields & kOdomInfoWords)
 	{
 		msg.wordsKeys = uKeys(info.words);
-		keypointsToROS(uValues(info.words), msg.wordsValues);
+		if(packedFeatures)
+		{
+			keypointsToROS(uValues(info.words), msg.wordsValuesPacked);
+		}
+		else
+		{
+			keypointsToROS(uValues(info.words), msg.wordsValues);
+		}
+	}
 
+	if(fields & kOdomInfoWordMatches)
+	{
 		msg.wordMatches = info.reg.matchesIDs;
 		msg.wordInliers = info.reg.inliersIDs;
+	}
 
+	if(fields & kOdomInfoCorners)
+	{
 		points2fToROS(info.refCorners, msg.refCorners);
 		points2fToROS(info.newCorners, msg.newCorners);
 		msg.cornerInliers = info.cornerInliers;
+	}
 
+	if(fields & kOdomInfoLocalMap)
+	{
 		msg.localMapKeys = uKeys(info.localMap);
-		points3fToROS(uValues(info.localMap), msg.localMapValues);
+		if(packedFeatures)
+		{
+			points3fToROS(uValues(info.localMap), msg.localMapValuesPacked);
+		}
+		else
+		{
+			points3fToROS(uValues(info.localMap), msg.localMapValues);
+		}
+	}
 
+	if((fields & kOdomInfoLocalScanMap) && !info.localScanMap.isEmpty())
+	{
 		pcl_conversions::moveFromPCL(*rtabmap::util3d::laserScanToPointCloud2(info.localScanMap, info.localScanMap.localTransform()), msg.localScanMap);
 	}
 }
@@ -1899,7 +2344,7 @@ rtabmap::Landmarks landmarksFromROS(
 		const std::string & frameId,
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		double defaultLinVariance,
 		double defaultAngVariance)
@@ -1966,7 +2411,7 @@ rtabmap::Transform getTransform(
 		const std::string & fromFrameId,
 		const std::string & toFrameId,
 		const ros::Time & stamp,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform)
 {
 	// TF ready?
@@ -2003,7 +2448,7 @@ rtabmap::Transform getMovingTransform(
 		const std::string & fixedFrame,
 		const ros::Time & stampFrom,
 		const ros::Time & stampTo,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform)
 {
 	// TF ready?
@@ -2045,7 +2490,7 @@ bool convertRGBDMsgs(
 		cv::Mat & depth,
 		std::vector<rtabmap::CameraModel> & cameraModels,
 		std::vector<rtabmap::StereoCameraModel> & stereoCameraModels,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool alreadRectifiedImages,
 		const std::vector<std::vector<rtabmap_msgs::KeyPoint> > & localKeyPointsMsgs,
@@ -2287,7 +2732,7 @@ bool convertRGBDMsgs(
 
 		if(isDepth)
 		{
-			cameraModels.push_back(rtabmap_conversions::cameraModelFromROS(cameraInfoMsgs[i], localTransform));
+			cameraModels.push_back(rtabmap_conversions::cameraModelFromROS(cameraInfoMsgs[i], localTransform, !alreadRectifiedImages));
 		}
 		else //stereo
 		{
@@ -2344,7 +2789,7 @@ bool convertRGBDMsgs(
 				}
 			}
 
-			rtabmap::StereoCameraModel stereoModel = rtabmap_conversions::stereoCameraModelFromROS(cameraInfoMsgs[i], depthCameraInfoMsgs[i], localTransform, stereoTransform);
+			rtabmap::StereoCameraModel stereoModel = rtabmap_conversions::stereoCameraModelFromROS(cameraInfoMsgs[i], depthCameraInfoMsgs[i], localTransform, stereoTransform, !alreadRectifiedImages);
 
 			if(stereoModel.baseline() > 10.0)
 			{
@@ -2437,7 +2882,7 @@ bool convertStereoMsg(
 		cv::Mat & left,
 		cv::Mat & right,
 		rtabmap::StereoCameraModel & stereoModel,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool alreadyRectified)
 {
@@ -2530,7 +2975,7 @@ bool convertStereoMsg(
 		}
 	}
 
-	stereoModel = rtabmap_conversions::stereoCameraModelFromROS(leftCamInfoMsg, rightCamInfoMsg, localTransform, stereoTransform);
+	stereoModel = rtabmap_conversions::stereoCameraModelFromROS(leftCamInfoMsg, rightCamInfoMsg, localTransform, stereoTransform, !alreadyRectified);
 
 	if(stereoModel.baseline() > 10.0)
 	{
@@ -2583,13 +3028,172 @@ bool convertStereoMsg(
 	return true;
 }
 
+namespace {
+struct LaserScanDirectionsKey
+{
+	std::string frameId;
+	float angleMin;
+	float angleIncrement;
+	size_t size;
+	bool operator<(const LaserScanDirectionsKey & k) const
+	{
+		if(size != k.size) return size < k.size;
+		if(angleMin != k.angleMin) return angleMin < k.angleMin;
+		if(angleIncrement != k.angleIncrement) return angleIncrement < k.angleIncrement;
+		return frameId < k.frameId;
+	}
+};
+UMutex g_laserScanDirectionsMutex;
+std::map<LaserScanDirectionsKey, cv::Mat> g_laserScanDirections;
+
+// 2xN table (cos, sin) of beam directions, cached for each sensor layout
+cv::Mat laserScanDirections(const sensor_msgs::LaserScan & msg)
+{
+	LaserScanDirectionsKey key;
+	key.frameId = msg.header.frame_id;
+	key.angleMin = msg.angle_min;
+	key.angleIncrement = msg.angle_increment;
+	key.size = msg.ranges.size();
+
+	UScopeMutex lock(g_laserScanDirectionsMutex);
+	std::map<LaserScanDirectionsKey, cv::Mat>::iterator iter = g_laserScanDirections.find(key);
+	if(iter != g_laserScanDirections.end())
+	{
+		return iter->second;
+	}
+	if(g_laserScanDirections.size() >= 32)
+	{
+		// should not happen with a fixed set of sensors
+		g_laserScanDirections.clear();
+	}
+	cv::Mat table(2, key.size, CV_32FC1);
+	for(size_t i=0; i<key.size; ++i)
+	{
+		double angle = double(msg.angle_min) + double(msg.angle_increment)*double(i);
+		table.at<float>(0,i) = cos(angle);
+		table.at<float>(1,i) = sin(angle);
+	}
+	g_laserScanDirections.insert(std::make_pair(key, table));
+	return table;
+}
+} // namespace
+
+cv::Mat laserScanToPoints(
+		const sensor_msgs::LaserScan & msg,
+		bool is2D,
+		const rtabmap::Transform & motion,
+		const rtabmap::Transform & transform)
+{
+	size_t size = msg.ranges.size();
+	bool hasIntensity = !msg.intensities.empty() && msg.intensities.size() == size;
+	int dims = is2D?2:3;
+	int channels = dims + (hasIntensity?1:0);
+	if(size == 0)
+	{
+		return cv::Mat(1, 0, CV_32FC(channels));
+	}
+	cv::Mat table = laserScanDirections(msg);
+	const float * cosPtr = table.ptr<float>(0);
+	const float * sinPtr = table.ptr<float>(1);
+	const float * ranges = msg.ranges.data();
+
+	std::vector<float> buffer(size*3, 0.0f);
+	float * __restrict xs = buffer.data();
+	float * __restrict ys = xs+size;
+	float * __restrict zs = ys+size;
+	for(size_t i=0; i<size; ++i)
+	{
+		xs[i] = ranges[i]*cosPtr[i];
+		ys[i] = ranges[i]*sinPtr[i];
+	}
+
+	bool moving = !motion.isNull() && !motion.isIdentity();
+	bool transformed = !transform.isNull() && !transform.isIdentity();
+	const rtabmap::Transform identity = rtabmap::Transform::getIdentity();
+	const float * f = transformed?transform.data():identity.data();
+	// copy the fixed 3x4 matrix so that the loops only touch plain floats
+	const float m00=f[0], m01=f[1], m02=f[2], m03=f[3];
+	const float m10=f[4], m11=f[5], m12=f[6], m13=f[7];
+	const float m20=f[8], m21=f[9], m22=f[10], m23=f[11];
+	if(moving)
+	{
+		// Motion is interpolated from identity to "motion" along the scan:
+		// translation linearly, rotation with a normalized quaternion lerp
+		// (same as slerp for the small rotations done during one scan).
+		Eigen::Quaternionf q = motion.getQuaternionf();
+		if(q.w() < 0.0f)
+		{
+			q.coeffs() *= -1.0f;
+		}
+		const float qw=q.w(), qx=q.x(), qy=q.y(), qz=q.z();
+		const float tx=motion.x(), ty=motion.y(), tz=motion.z();
+		const float step = 1.0f/float(size);
+		for(size_t i=0; i<size; ++i)
+		{
+			float s = float(i)*step;
+			float w = 1.0f - s + s*qw;
+			float a = s*qx;
+			float b = s*qy;
+			float c = s*qz;
+			float k = 2.0f/(w*w + a*a + b*b + c*c);
+			// first two columns of the rotation matrix (beams have z=0)
+			float r00 = 1.0f - k*(b*b + c*c);
+			float r10 = k*(a*b + w*c);
+			float r20 = k*(a*c - w*b);
+			float r01 = k*(a*b - w*c);
+			float r11 = 1.0f - k*(a*a + c*c);
+			float r21 = k*(b*c + w*a);
+			float x = xs[i];
+			float y = ys[i];
+			float px = r00*x + r01*y + s*tx;
+			float py = r10*x + r11*y + s*ty;
+			float pz = r20*x + r21*y + s*tz;
+			xs[i] = m00*px + m01*py + m02*pz + m03;
+			ys[i] = m10*px + m11*py + m12*pz + m13;
+			zs[i] = m20*px + m21*py + m22*pz + m23;
+		}
+	}
+	else if(transformed)
+	{
+		for(size_t i=0; i<size; ++i)
+		{
+			float x = xs[i];
+			float y = ys[i];
+			xs[i] = m00*x + m01*y + m03;
+			ys[i] = m10*x + m11*y + m13;
+			zs[i] = m20*x + m21*y + m23;
+		}
+	}
+
+	// Compaction, same range filtering than laser_geometry
+	cv::Mat data(1, size, CV_32FC(channels));
+	float * out = data.ptr<float>();
+	int oi = 0;
+	for(size_t i=0; i<size; ++i)
+	{
+		float * o = out + oi*channels;
+		o[0] = xs[i];
+		o[1] = ys[i];
+		if(!is2D)
+		{
+			o[2] = zs[i];
+		}
+		if(hasIntensity)
+		{
+			o[dims] = msg.intensities[i];
+		}
+		oi += (ranges[i] >= msg.range_min && ranges[i] < msg.range_max)?1:0;
+	}
+	return data.colRange(0, oi);
+}
+
 bool convertScanMsg(
 		const sensor_msgs::LaserScan & scan2dMsg,
 		const std::string & frameId,
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
 		rtabmap::LaserScan & scan,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool outputInFrameId)
 {
@@ -2635,23 +3239,6 @@ bool convertScanMsg(
 		return false;
 	}
 
-	//transform in frameId_ frame
-	sensor_msgs::PointCloud2 scanOut;
-	laser_geometry::LaserProjection projection;
-	projection.transformLaserScanToPointCloud(odomFrameId.empty()?frameId:odomFrameId, scan2dMsg, scanOut, listener);
-
-	//transform back in laser frame
-	rtabmap::Transform laserToOdom = getTransform(
-			scan2dMsg.header.frame_id,
-			odomFrameId.empty()?frameId:odomFrameId,
-			scan2dMsg.header.stamp,
-			listener,
-			waitForTransform);
-	if(laserToOdom.isNull())
-	{
-		return false;
-	}
-
 	// sync with odometry stamp
 	if(!odomFrameId.empty() && odomStamp != scan2dMsg.header.stamp)
 	{
@@ -2674,52 +3261,15 @@ bool convertScanMsg(
 		}
 	}
 
-	if(outputInFrameId)
-	{
-		laserToOdom *= scanLocalTransform;
-	}
-
-	bool hasIntensity = false;
-	for(unsigned int i=0; i<scanOut.fields.size(); ++i)
-	{
-		if(scanOut.fields[i].name.compare("intensity") == 0)
-		{
-			if(scanOut.fields[i].datatype == sensor_msgs::PointField::FLOAT32)
-			{
-				hasIntensity = true;
-			}
-			else
-			{
-				static bool warningShown = false;
-				if(!warningShown)
-				{
-					ROS_WARN("The input scan cloud has an \"intensity\" field "
-							"but the datatype (%d) is not supported. Intensity will be ignored. "
-							"This message is only shown once.", scanOut.fields[i].datatype);
-					warningShown = true;
-				}
-			}
-		}
-	}
-
-	rtabmap::LaserScan::Format format;
-	cv::Mat data;
-	if(hasIntensity)
-	{
-		pcl::PointCloud<pcl::PointXYZI>::Ptr pclScan(new pcl::PointCloud<pcl::PointXYZI>);
-		pcl::fromROSMsg(scanOut, *pclScan);
-		pclScan->is_dense = true;
-		data = rtabmap::util3d::laserScan2dFromPointCloud(*pclScan, laserToOdom).data(); // put back in laser frame
-		format = rtabmap::LaserScan::kXYI;
-	}
-	else
-	{
-		pcl::PointCloud<pcl::PointXYZ>::Ptr pclScan(new pcl::PointCloud<pcl::PointXYZ>);
-		pcl::fromROSMsg(scanOut, *pclScan);
-		pclScan->is_dense = true;
-		data = rtabmap::util3d::laserScan2dFromPointCloud(*pclScan, laserToOdom).data(); // put back in laser frame
-		format = rtabmap::LaserScan::kXY;
-	}
+	// Project in laser frame at scan stamp, deskewed with the motion of the
+	// laser during the scan (tmpT), then optionally put in frameId_ frame.
+	bool hasIntensity = !scan2dMsg.intensities.empty() && scan2dMsg.intensities.size() == scan2dMsg.ranges.size();
+	rtabmap::LaserScan::Format format = hasIntensity?rtabmap::LaserScan::kXYI:rtabmap::LaserScan::kXY;
+	cv::Mat data = laserScanToPoints(
+			scan2dMsg,
+			true,
+			tmpT,
+			outputInFrameId?scanLocalTransform:rtabmap::Transform());
 
 	rtabmap::Transform zAxis(0,0,1,0,0,0);
 	if((scanLocalTransform.rotation()*zAxis).z() < 0)
@@ -2748,11 +3298,12 @@ bool convertScan3dMsg(
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
 		rtabmap::LaserScan & scan,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		int maxPoints,
 		float maxRange,
-		bool is2D)
+		bool is2D,
+		float minRange)
 {
 	UASSERT_MSG(scan3dMsg.data.size() == scan3dMsg.row_step*scan3dMsg.height,
 			uFormat("data=%d row_step=%d height=%d", scan3dMsg.data.size(), scan3dMsg.row_step, scan3dMsg.height).c_str());
@@ -2784,8 +3335,314 @@ bool convertScan3dMsg(
 			scanLocalTransform = sensorT * scanLocalTransform;
 		}
 	}
-	scan = rtabmap::util3d::laserScanFromPointCloud(scan3dMsg, true, is2D);
-	scan = rtabmap::LaserScan(scan, maxPoints, maxRange, scanLocalTransform);
+	scan = laserScanFromROS(scan3dMsg, scanLocalTransform, maxPoints, maxRange, minRange, is2D);
+	return true;
+}
+
+rtabmap::LaserScan laserScanFromROS(
+		const sensor_msgs::PointCloud2 & msg,
+		const rtabmap::Transform & localTransform,
+		int maxPoints,
+		float maxRange,
+		float minRange,
+		bool is2D)
+{
+	int offsetX=-1, offsetY=-1, offsetZ=-1;
+	int offsetI=-1, offsetRGB=-1, offsetTime=-1;
+	int offsetNx=-1, offsetNy=-1, offsetNz=-1;
+	int timeDatatype = 0;
+	bool supported = !msg.is_bigendian;
+	for(size_t i=0; i<msg.fields.size() && supported; ++i)
+	{
+		const sensor_msgs::PointField & field = msg.fields[i];
+		bool isFloat = field.datatype == sensor_msgs::PointField::FLOAT32;
+		if(field.name.compare("x") == 0) {offsetX = field.offset; supported = isFloat;}
+		else if(field.name.compare("y") == 0) {offsetY = field.offset; supported = isFloat;}
+		else if(field.name.compare("z") == 0) {offsetZ = field.offset; supported = isFloat;}
+		else if(field.name.compare("intensity") == 0 || field.name.compare("i") == 0)
+		{
+			offsetI = field.offset;
+			supported = isFloat;
+		}
+		else if(field.name.compare("rgb") == 0 || field.name.compare("rgba") == 0)
+		{
+			// packed color is copied as is
+			offsetRGB = field.offset;
+			supported = isFloat || field.datatype == sensor_msgs::PointField::UINT32;
+		}
+		else if(field.name.compare("normal_x") == 0) {offsetNx = field.offset; supported = isFloat;}
+		else if(field.name.compare("normal_y") == 0) {offsetNy = field.offset; supported = isFloat;}
+		else if(field.name.compare("normal_z") == 0) {offsetNz = field.offset; supported = isFloat;}
+		else if(field.name.compare("t") == 0 ||
+				field.name.compare("time") == 0 ||
+				field.name.compare("stamps") == 0 ||
+				field.name.compare("timestamp") == 0)
+		{
+			offsetTime = field.offset;
+			timeDatatype = field.datatype;
+		}
+		// other fields (e.g., ring) are ignored
+	}
+	bool hasNormals = offsetNx>=0 && offsetNy>=0 && offsetNz>=0;
+	bool hasTime = offsetTime>=0 && timeDatatype>=6 && timeDatatype<=8;
+	if(!supported || offsetX<0 || offsetY<0 || (!is2D && offsetZ<0))
+	{
+		// Fallback to generic conversion
+		rtabmap::LaserScan scan = rtabmap::util3d::laserScanFromPointCloud(msg, true, is2D);
+		return rtabmap::LaserScan(scan, maxPoints, maxRange, localTransform);
+	}
+
+	// Output layout, following rtabmap::LaserScan formats
+	std::vector<int> offsets;
+	rtabmap::LaserScan::Format format;
+	offsets.push_back(offsetX);
+	offsets.push_back(offsetY);
+	if(is2D)
+	{
+		if(offsetI>=0) offsets.push_back(offsetI);
+		if(hasNormals)
+		{
+			offsets.push_back(offsetNx);
+			offsets.push_back(offsetNy);
+			offsets.push_back(offsetNz);
+			format = offsetI>=0?rtabmap::LaserScan::kXYINormal:rtabmap::LaserScan::kXYNormal;
+		}
+		else
+		{
+			format = offsetI>=0?rtabmap::LaserScan::kXYI:rtabmap::LaserScan::kXY;
+		}
+		hasTime = false;
+	}
+	else
+	{
+		offsets.push_back(offsetZ);
+		if(hasNormals)
+		{
+			if(offsetRGB>=0) offsets.push_back(offsetRGB);
+			else if(offsetI>=0) offsets.push_back(offsetI);
+			offsets.push_back(offsetNx);
+			offsets.push_back(offsetNy);
+			offsets.push_back(offsetNz);
+			format = offsetRGB>=0?rtabmap::LaserScan::kXYZRGBNormal:offsetI>=0?rtabmap::LaserScan::kXYZINormal:rtabmap::LaserScan::kXYZNormal;
+			hasTime = false;
+		}
+		else if(offsetRGB>=0)
+		{
+			offsets.push_back(offsetRGB);
+			format = rtabmap::LaserScan::kXYZRGB;
+			hasTime = false;
+		}
+		else if(hasTime)
+		{
+			// intensity is set to 0 if not available, time is added below
+			offsets.push_back(offsetI);
+			format = rtabmap::LaserScan::kXYZIT;
+		}
+		else
+		{
+			if(offsetI>=0) offsets.push_back(offsetI);
+			format = offsetI>=0?rtabmap::LaserScan::kXYZI:rtabmap::LaserScan::kXYZ;
+		}
+	}
+	int channels = offsets.size() + (hasTime?1:0);
+	int fields = offsets.size();
+
+	// One pass over the raw buffer: copy, filter NaNs and range
+	cv::Mat data(1, msg.width*msg.height, CV_32FC(channels));
+	float minRangeSqr = minRange*minRange;
+	float maxRangeSqr = maxRange>0.0f?maxRange*maxRange:std::numeric_limits<float>::max();
+	double headerStamp = msg.header.stamp.toSec();
+	float * out = data.ptr<float>();
+	int oi = 0;
+	for(unsigned int row=0; row<msg.height; ++row)
+	{
+		const unsigned char * rowPtr = &msg.data[row*msg.row_step];
+		for(unsigned int col=0; col<msg.width; ++col)
+		{
+			const unsigned char * ptr = rowPtr + col*msg.point_step;
+			float * o = out + oi*channels;
+			for(int k=0; k<fields; ++k)
+			{
+				if(offsets[k] >= 0)
+				{
+					memcpy(o+k, ptr+offsets[k], sizeof(float));
+				}
+				else
+				{
+					o[k] = 0.0f;
+				}
+			}
+			if(hasTime)
+			{
+				const unsigned char * t = ptr+offsetTime;
+				o[fields] = timeDatatype==6?float(double(*((const unsigned int*)t))*1e-9):
+						    timeDatatype==7?*((const float*)t):
+						    float(*((const double*)t) - headerStamp);
+			}
+			float x = o[0];
+			float y = o[1];
+			float z = is2D?0.0f:o[2];
+			float r = x*x + y*y + z*z;
+			// std::isfinite(r) also rejects NaN/inf coordinates
+			oi += (std::isfinite(r) && r>=minRangeSqr && r<=maxRangeSqr)?1:0;
+		}
+	}
+	return rtabmap::LaserScan(data.colRange(0, oi), maxPoints, maxRange, format, localTransform);
+}
+
+inline ros::Time deskewPointStamp(const unsigned char * timePtr, int timeDatatype, const ros::Time & headerStamp)
+{
+	if(timeDatatype == 6) // UINT32
+	{
+		return headerStamp+ros::Duration(0, *((const unsigned int*)timePtr));
+	}
+	else if(timeDatatype == 7) // FLOAT32
+	{
+		return headerStamp+ros::Duration().fromSec(*((const float*)timePtr));
+	}
+	// FLOAT64
+	return ros::Time(*((const double*)timePtr));
+}
+
+// Transform all points of a line with the same transform. xyz are
+// unpacked in SoA buffers so that the transform loop can be vectorized.
+void deskewLine(
+		unsigned char * data,
+		size_t size,
+		size_t pointStep,
+		int offsetX,
+		int offsetY,
+		int offsetZ,
+		int offsetTime,
+		size_t timeSize,
+		const float * m, // 3x4 row-major
+		float * buffer)  // 3*size
+{
+	float * __restrict xs = buffer;
+	float * __restrict ys = buffer+size;
+	float * __restrict zs = buffer+size*2;
+	for(size_t i=0; i<size; ++i)
+	{
+		const unsigned char * ptr = data + i*pointStep;
+		memcpy(xs+i, ptr+offsetX, sizeof(float));
+		memcpy(ys+i, ptr+offsetY, sizeof(float));
+		memcpy(zs+i, ptr+offsetZ, sizeof(float));
+	}
+	const float r11=m[0], r12=m[1], r13=m[2], tx=m[3];
+	const float r21=m[4], r22=m[5], r23=m[6], ty=m[7];
+	const float r31=m[8], r32=m[9], r33=m[10], tz=m[11];
+	for(size_t i=0; i<size; ++i)
+	{
+		float x = xs[i];
+		float y = ys[i];
+		float z = zs[i];
+		xs[i] = r11*x + r12*y + r13*z + tx;
+		ys[i] = r21*x + r22*y + r23*z + ty;
+		zs[i] = r31*x + r32*y + r33*z + tz;
+	}
+	for(size_t i=0; i<size; ++i)
+	{
+		unsigned char * ptr = data + i*pointStep;
+		memcpy(ptr+offsetX, xs+i, sizeof(float));
+		memcpy(ptr+offsetY, ys+i, sizeof(float));
+		memcpy(ptr+offsetZ, zs+i, sizeof(float));
+		memset(ptr+offsetTime, 0, timeSize);
+	}
+}
+
+rtabmap::Transform interpolateTrajectory(const std::map<double, rtabmap::Transform> & trajectory, double stamp)
+{
+	UASSERT(!trajectory.empty());
+	std::map<double, rtabmap::Transform>::const_iterator iter = trajectory.lower_bound(stamp);
+	if(iter == trajectory.end())
+	{
+		return trajectory.rbegin()->second;
+	}
+	if(iter == trajectory.begin() || iter->first == stamp)
+	{
+		return iter->second;
+	}
+	std::map<double, rtabmap::Transform>::const_iterator previous = iter;
+	--previous;
+	return previous->second.interpolate((stamp - previous->first) / (iter->first - previous->first), iter->second);
+}
+
+// Integrate angular velocities of the IMU (and the linear velocity of
+// odometry, if set) between two stamps. Returned poses are of the sensor
+// frame (localTransform is base->sensor) relative to its pose at referenceStamp.
+bool integrateImuTrajectory(
+		const std::map<double, rtabmap::IMU> & imus,
+		double fromStamp,
+		double toStamp,
+		double referenceStamp,
+		const rtabmap::Transform & localTransform,
+		const rtabmap::Transform & velocity,
+		std::map<double, rtabmap::Transform> & trajectory)
+{
+	double start = std::min(fromStamp, referenceStamp);
+	double end = std::max(toStamp, referenceStamp);
+	std::map<double, rtabmap::IMU>::const_iterator iter = imus.upper_bound(start);
+	if(iter == imus.begin())
+	{
+		ROS_ERROR("IMU buffer (oldest=%f) doesn't cover the beginning of the scan (%f)!", imus.begin()->first, start);
+		return false;
+	}
+	--iter;
+	if(imus.rbegin()->first < end)
+	{
+		// Last angular velocity is kept up to end of the scan
+		ROS_DEBUG("IMU buffer (latest=%f) doesn't cover the end of the scan (%f), extrapolating %fs.",
+				imus.rbegin()->first, end, end - imus.rbegin()->first);
+	}
+
+	Eigen::Vector3d v = Eigen::Vector3d::Zero();
+	if(!velocity.isNull())
+	{
+		v = Eigen::Vector3d(velocity.x(), velocity.y(), velocity.z());
+	}
+
+	// Poses of base frame relative to its pose at start
+	std::map<double, rtabmap::Transform> basePoses;
+	Eigen::Quaterniond q = Eigen::Quaterniond::Identity();
+	Eigen::Vector3d p = Eigen::Vector3d::Zero();
+	double t = start;
+	basePoses.insert(std::make_pair(t, rtabmap::Transform::getIdentity()));
+	while(t < end)
+	{
+		std::map<double, rtabmap::IMU>::const_iterator next = iter;
+		++next;
+		double tNext = next==imus.end()?end:std::min(next->first, end);
+		double dt = tNext - t;
+		if(dt > 0.0)
+		{
+			const cv::Vec3d & w = iter->second.angularVelocity();
+			Eigen::Vector3d omega = iter->second.localTransform().toEigen3d().linear() * Eigen::Vector3d(w[0], w[1], w[2]);
+			Eigen::Quaterniond qNext = q;
+			double angle = omega.norm()*dt;
+			if(angle > 0.0)
+			{
+				qNext = (q * Eigen::Quaterniond(Eigen::AngleAxisd(angle, omega.normalized()))).normalized();
+			}
+			p += q.slerp(0.5, qNext) * v * dt;
+			q = qNext;
+			Eigen::Affine3d pose = Eigen::Translation3d(p) * q;
+			basePoses.insert(std::make_pair(tNext, rtabmap::Transform::fromEigen3d(pose)));
+		}
+		t = tNext;
+		if(next == imus.end())
+		{
+			break;
+		}
+		iter = next;
+	}
+
+	rtabmap::Transform referenceInv = interpolateTrajectory(basePoses, referenceStamp).inverse();
+	rtabmap::Transform localTransformInv = localTransform.inverse();
+	trajectory.clear();
+	for(std::map<double, rtabmap::Transform>::iterator jter=basePoses.begin(); jter!=basePoses.end(); ++jter)
+	{
+		trajectory.insert(trajectory.end(), std::make_pair(jter->first, localTransformInv * referenceInv * jter->second * localTransform));
+	}
 	return true;
 }
 
@@ -2793,13 +3650,28 @@ bool deskew_impl(
 		const sensor_msgs::PointCloud2 & input,
 		sensor_msgs::PointCloud2 & output,
 		const std::string & fixedFrameId,
-		tf::TransformListener * listener,
+		tf::Transformer * listener,
 		double waitForTransform,
 		bool slerp,
 		const rtabmap::Transform & velocity,
-		double previousStamp)
+		double previousStamp,
+		const std::map<double, rtabmap::IMU> * imus = 0,
+		const rtabmap::Transform & localTransform = rtabmap::Transform())
 {
-	if(listener != 0)
+	if(imus != 0)
+	{
+		if(imus->empty())
+		{
+			ROS_ERROR("IMU buffer is empty!");
+			return false;
+		}
+		if(localTransform.isNull())
+		{
+			ROS_ERROR("localTransform should be valid when IMU is used!");
+			return false;
+		}
+	}
+	else if(listener != 0)
 	{
 		if(input.header.frame_id.empty())
 		{
@@ -2907,176 +3779,41 @@ bool deskew_impl(
 		return false;
 	}
 
+	if(!(timeDatatype >=6 && timeDatatype<=8))
+	{
+		ROS_ERROR("Only lidar timestamp channel data type 6, 7 or 8 is supported! (received %d)", timeDatatype);
+		return false;
+	}
+
+	// All points of a line (a column for ouster-like clouds, a row for
+	// velodyne-like clouds) share the same timestamp:
+	//  ouster point cloud:      velodyne point cloud:
+	//  t1     t2    ...         t1  ring1 ring2 ring3 ...
+	//  ring1  ring1 ...         t2  ring1 ring2 ring3 ...
+	//  ring2  ring2 ...         t3  ring1 ring2 ring3 ...
 	bool timeOnColumns = input.width > input.height;
+	size_t lines = timeOnColumns?input.width:input.height;
+	size_t pointsPerLine = timeOnColumns?input.height:input.width;
+	size_t lineStep = timeOnColumns?input.point_step:input.row_step;
+	size_t pointStep = timeOnColumns?input.row_step:input.point_step;
 
-	// Get latest timestamp
+	// Read line stamps and search first/last stamps in the same pass
+	std::vector<ros::Time> lineStamps(lines);
 	ros::Time firstStamp;
 	ros::Time lastStamp;
-	if(timeDatatype == 6) // UINT32
+	for(size_t i=0; i<lines; ++i)
 	{
-		unsigned int nsecFirst = *((const unsigned int*)(&input.data[0]+offsetTime));
-		unsigned int nsecLast = *((const unsigned int*)(&input.data[(input.width-1)*input.point_step + input.row_step*(input.height-1)]+offsetTime));
-
-		if(nsecFirst > nsecLast)
+		lineStamps[i] = deskewPointStamp(&input.data[i*lineStep]+offsetTime, timeDatatype, input.header.stamp);
+		if(i==0 || lineStamps[i] < firstStamp)
 		{
-			// scans are not ordered, we need to search min/max
-			static bool warned = false;
-			if(!warned) {
-				ROS_WARN("Timestamp channel is not ordered, we will have to parse every scans to "
-					  "determinate first and last time offsets. This will add slightly computation "
-					  "time. This warning is only shown once.");
-				warned = true;
-			}
-			if(timeOnColumns)
-			{
-				for(size_t i=0; i<input.width; ++i)
-				{
-					unsigned int nsec = *((const unsigned int*)(&input.data[(i)*input.point_step]+offsetTime));
-					if(nsec < nsecFirst)
-					{
-						nsecFirst = nsec;
-					}
-					else if(nsec > nsecLast)
-					{
-						nsecLast = nsec;
-					}
-				}
-			}
-			else
-			{
-				for(size_t i=0; i<input.height; ++i)
-				{
-					unsigned int nsec = *((const unsigned int*)(&input.data[input.row_step*(i)]+offsetTime));
-					if(nsec < nsecFirst)
-					{
-						nsecFirst = nsec;
-					}
-					else if(nsec > nsecLast)
-					{
-						nsecLast = nsec;
-					}
-				}
-			}
+			firstStamp = lineStamps[i];
 		}
-
-		firstStamp = input.header.stamp+ros::Duration(0, nsecFirst);
-		lastStamp = input.header.stamp+ros::Duration(0, nsecLast);
-	}
-	else if(timeDatatype == 7) // FLOAT32
-	{
-		float secFirst = *((const float*)(&input.data[0]+offsetTime));
-		float secLast = *((const float*)(&input.data[(input.width-1)*input.point_step + input.row_step*(input.height-1)]+offsetTime));
-
-		if(secFirst > secLast)
+		if(i==0 || lineStamps[i] > lastStamp)
 		{
-			// scans are not ordered, we need to search min/max
-			static bool warned = false;
-			if(!warned) {
-				ROS_WARN("Timestamp channel is not ordered, we will have to parse every scans to "
-					  "determinate first and last time offsets. This will add slightly computation "
-					  "time. This warning is only shown once.");
-				warned = true;
-			}
-			if(timeOnColumns)
-			{
-				for(size_t i=0; i<input.width; ++i)
-				{
-					float sec = *((const float*)(&input.data[(i)*input.point_step]+offsetTime));
-					if(sec < secFirst)
-					{
-						secFirst = sec;
-					}
-					else if(sec > secLast)
-					{
-						secLast = sec;
-					}
-				}
-			}
-			else
-			{
-				for(size_t i=0; i<input.height; ++i)
-				{
-					float sec = *((const float*)(&input.data[input.row_step*(i)]+offsetTime));
-					if(sec < secFirst)
-					{
-						secFirst = sec;
-					}
-					else if(sec > secLast)
-					{
-						secLast = sec;
-					}
-				}
-			}
+			lastStamp = lineStamps[i];
 		}
-
-		firstStamp = input.header.stamp+ros::Duration().fromSec(secFirst);
-		lastStamp = input.header.stamp+ros::Duration().fromSec(secLast);
 	}
-	else if(timeDatatype == 8) // FLOAT64
-	{
-		double secFirst = *((const double*)(&input.data[0]+offsetTime));
-		double secLast = *((const double*)(&input.data[(input.width-1)*input.point_step + input.row_step*(input.height-1)]+offsetTime));
-		if(secFirst > secLast)
-		{
-			// scans are not ordered, we need to search min/max
-			static bool warned = false;
-			if(!warned) {
-				ROS_WARN("Timestamp channel is not ordered, we will have to parse every scans to "
-					  "determinate first and last time offsets. This will add slightly computation "
-					  "time. This warning is only shown once.");
-				warned = true;
-			}
-			if(timeOnColumns)
-			{
-				for(size_t i=0; i<input.width; ++i)
-				{
-					double sec = *((const double*)(&input.data[(i)*input.point_step]+offsetTime));
-					if(sec < secFirst)
-					{
-						secFirst = sec;
-					}
-					else if(sec > secLast)
-					{
-						secLast = sec;
-					}
-				}
-			}
-			else
-			{
-				for(size_t i=0; i<input.height; ++i)
-				{
-					double sec = *((const double*)(&input.data[input.row_step*(i)]+offsetTime));
-					if(sec < secFirst)
-					{
-						secFirst = sec;
-					}
-					else if(sec > secLast)
-					{
-						secLast = sec;
-					}
-				}
-			}
-		}
-
-		firstStamp = ros::Time(secFirst);
-		lastStamp = ros::Time(secLast);
-	}
-	else
-	{
-		ROS_ERROR("Not supported time datatype %d!", timeDatatype);
-		return false;
-	}
-	if(!(timeDatatype >=6 && timeDatatype<=8))
-	{
-		ROS_ERROR("Only lidar timestamp channel data type 6, 7 or 8 is supported! (received %d)", timeDatatype);
-		return false;
-	}
-	if(lastStamp < firstStamp)
-	{
-		ROS_ERROR("Last stamp (%f) is smaller than first stamp (%f) (header=%f)!", lastStamp.toSec(), firstStamp.toSec(), input.header.stamp.toSec());
-		return false;
-	}
-	else if(lastStamp == firstStamp)
+	if(lastStamp == firstStamp)
 	{
 		ROS_ERROR("First and last stamps in the scan are the same (%f) (header=%f)!", lastStamp.toSec(), input.header.stamp.toSec());
 		return false;
@@ -3107,7 +3844,22 @@ bool deskew_impl(
 	rtabmap::Transform firstPose;
 	rtabmap::Transform lastPose;
 	double scanTime = 0;
-	if(slerp)
+	std::map<double, rtabmap::Transform> trajectory;
+	if(imus != 0)
+	{
+		if(!integrateImuTrajectory(
+				*imus,
+				firstStamp.toSec(),
+				lastStamp.toSec(),
+				input.header.stamp.toSec(),
+				localTransform,
+				velocity,
+				trajectory))
+		{
+			return false;
+		}
+	}
+	else if(slerp)
 	{
 		if(listener != 0)
 		{
@@ -3172,168 +3924,65 @@ bool deskew_impl(
 	}
 	//else tf will be used to get more accurate transforms
 
-	output = input;
-	ros::Time stamp;
 	UTimer processingTime;
-	if(timeOnColumns)
+
+	// One transform per line, lines with the same stamp share the same transform
+	std::vector<rtabmap::Transform> lineTransforms(lines);
+	for(size_t i=0; i<lines; ++i)
 	{
-		// ouster point cloud:
-		// t1     t2    ...
-		// ring1  ring1 ...
-		// ring2  ring2 ...
-		// ring3  ring4 ...
-		// ring4  ring3 ...
-		for(size_t u=0; u<output.width; ++u)
+		if(i>0 && lineStamps[i] == lineStamps[i-1])
 		{
-			if(timeDatatype == 6) // UINT32
-			{
-				unsigned int nsec = *((const unsigned int*)(&output.data[u*output.point_step]+offsetTime));
-				stamp = input.header.stamp+ros::Duration(0, nsec);
-			}
-			else if(timeDatatype == 7) //float 32
-			{
-				float sec = *((const float*)(&output.data[u*output.point_step]+offsetTime));
-				stamp = input.header.stamp+ros::Duration().fromSec(sec);
-			}
-			else if(timeDatatype == 8) //float64
-			{
-				double sec = *((const double*)(&output.data[u*output.point_step]+offsetTime));
-				stamp = ros::Time(sec);
-			}
-
-			rtabmap::Transform transform;
-			if(slerp)
-			{
-				transform = firstPose.interpolate((stamp-firstStamp).toSec() / scanTime, lastPose);
-			}
-			else
-			{
-				transform = rtabmap_conversions::getMovingTransform(
-						output.header.frame_id,
-						fixedFrameId,
-						output.header.stamp,
-						stamp,
-						*listener,
-						0);
-				if(transform.isNull())
-				{
-					ROS_ERROR("Could not get transform of %s accordingly to %s between stamps %f and %f!",
-							output.header.frame_id.c_str(),
-							fixedFrameId.c_str(),
-							stamp.toSec(),
-							output.header.stamp.toSec());
-					return false;
-				}
-			}
-
-			for(size_t v=0; v<input.height; ++v)
-			{
-				unsigned char * dataPtr = &output.data[v*output.row_step + u*output.point_step];
-				float & x = *((float*)(dataPtr+offsetX));
-				float & y = *((float*)(dataPtr+offsetY));
-				float & z = *((float*)(dataPtr+offsetZ));
-				pcl::PointXYZ pt(x,y,z);
-				pt = rtabmap::util3d::transformPoint(pt, transform);
-				x = pt.x;
-				y = pt.y;
-				z = pt.z;
-
-				// set delta stamp to zero so that on downstream they know the cloud is deskewed
-				if(timeDatatype == 6) // UINT32
-				{
-					*((unsigned int*)(dataPtr+offsetTime)) = 0;
-				}
-				else if(timeDatatype == 7)
-				{
-					*((float*)(dataPtr+offsetTime)) = 0;
-				}
-				else if(timeDatatype == 8)
-				{
-					*((double*)(dataPtr+offsetTime)) = 0;
-				}
-			}
+			lineTransforms[i] = lineTransforms[i-1];
 		}
-	}
-	else // time on rows
-	{
-		// velodyne point cloud:
-		// t1     ring1 ring2 ring3 ring4
-		// t2     ring1 ring2 ring3 ring4
-		// t3     ring1 ring2 ring3 ring4
-		// t4     ring1 ring2 ring3 ring4
-		// ...    ...   ...   ...   ...
-		for(size_t v=0; v<output.height; ++v)
+		else if(imus != 0)
 		{
-			if(timeDatatype == 6) // UINT32
-			{
-				unsigned int nsec = *((const unsigned int*)(&output.data[v*output.row_step]+offsetTime));
-				stamp = input.header.stamp+ros::Duration(0, nsec);
-			}
-			else if(timeDatatype == 7) //float 32
-			{
-				float sec = *((const float*)(&output.data[v*output.row_step]+offsetTime));
-				stamp = input.header.stamp+ros::Duration().fromSec(sec);
-			}
-			else if(timeDatatype == 8)
-			{
-				double sec = *((const double*)(&output.data[v*output.row_step]+offsetTime));
-				stamp = ros::Time(sec);
-			}
-
-			rtabmap::Transform transform;
-			if(slerp)
-			{
-				transform = firstPose.interpolate((stamp-firstStamp).toSec() / scanTime, lastPose);
-			}
-			else
-			{
-				transform = rtabmap_conversions::getMovingTransform(
-						output.header.frame_id,
-						fixedFrameId,
-						output.header.stamp,
-						stamp,
-						*listener,
-						0);
-				if(transform.isNull())
-				{
-					ROS_ERROR("Could not get transform of %s accordingly to %s between stamps %f and %f!",
-							output.header.frame_id.c_str(),
-							fixedFrameId.c_str(),
-							stamp.toSec(),
-							output.header.stamp.toSec());
-					return false;
-				}
-			}
-
-			for(size_t u=0; u<input.width; ++u)
+			lineTransforms[i] = interpolateTrajectory(trajectory, lineStamps[i].toSec());
+		}
+		else if(slerp)
+		{
+			lineTransforms[i] = firstPose.interpolate((lineStamps[i]-firstStamp).toSec() / scanTime, lastPose);
+		}
+		else
+		{
+			lineTransforms[i] = rtabmap_conversions::getMovingTransform(
+					input.header.frame_id,
+					fixedFrameId,
+					input.header.stamp,
+					lineStamps[i],
+					*listener,
+					0);
+			if(lineTransforms[i].isNull())
 			{
-				unsigned char * dataPtr = &output.data[v*output.row_step + u*output.point_step];
-				float & x = *((float*)(dataPtr+offsetX));
-				float & y = *((float*)(dataPtr+offsetY));
-				float & z = *((float*)(dataPtr+offsetZ));
-				pcl::PointXYZ pt(x,y,z);
-				pt = rtabmap::util3d::transformPoint(pt, transform);
-				x = pt.x;
-				y = pt.y;
-				z = pt.z;
-
-				// set delta stamp to zero so that on downstream they know the cloud is deskewed
-				if(timeDatatype == 6) // UINT32
-				{
-					*((unsigned int*)(dataPtr+offsetTime)) = 0;
-				}
-				else if(timeDatatype == 7)
-				{
-					*((float*)(dataPtr+offsetTime)) = 0;
-				}
-				else if(timeDatatype == 8)
-				{
-					*((double*)(dataPtr+offsetTime)) = 0;
-				}
+				ROS_ERROR("Could not get transform of %s accordingly to %s between stamps %f and %f!",
+						input.header.frame_id.c_str(),
+						fixedFrameId.c_str(),
+						lineStamps[i].toSec(),
+						input.header.stamp.toSec());
+				return false;
 			}
 		}
 	}
-	ROS_DEBUG("Lidar deskewing time=%fs", processingTime.elapsed());
+	double transformsTime = processingTime.ticks();
+
+	output = input;
+	// set delta stamp to zero so that on downstream they know the cloud is deskewed
+	size_t timeSize = timeDatatype == 8?sizeof(double):sizeof(float);
+	std::vector<float> buffer(pointsPerLine*3);
+	for(size_t i=0; i<lines; ++i)
+	{
+		deskewLine(
+				&output.data[i*lineStep],
+				pointsPerLine,
+				pointStep,
+				offsetX,
+				offsetY,
+				offsetZ,
+				offsetTime,
+				timeSize,
+				lineTransforms[i].data(),
+				buffer.data());
+	}
+	ROS_DEBUG("Lidar deskewing time=%fs (transforms=%fs, %d lines)", transformsTime + processingTime.elapsed(), transformsTime, (int)lines);
 	return true;
 }
 
@@ -3341,7 +3990,7 @@ bool deskew(
 		const sensor_msgs::PointCloud2 & input,
 		sensor_msgs::PointCloud2 & output,
 		const std::string & fixedFrameId,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool slerp)
 {
@@ -3357,4 +4006,14 @@ bool deskew(
 	return deskew_impl(input, output, "", 0, 0, true, velocity, previousStamp);
 }
 
+bool deskew(
+		const sensor_msgs::PointCloud2 & input,
+		sensor_msgs::PointCloud2 & output,
+		const std::map<double, rtabmap::IMU> & imus,
+		const rtabmap::Transform & localTransform,
+		const rtabmap::Transform & velocity)
+{
+	return deskew_impl(input, output, "", 0, 0, true, velocity, 0, &imus, localTransform);
+}
+
 }
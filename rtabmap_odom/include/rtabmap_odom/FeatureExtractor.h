@@ -0,0 +1,70 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef FEATUREEXTRACTOR_H_
+#define FEATUREEXTRACTOR_H_
+
+#include <rtabmap/core/SensorData.h>
+#include <rtabmap/core/Parameters.h>
+
+#include <vector>
+
+namespace rtabmap {
+class Feature2D;
+}
+
+namespace rtabmap_odom {
+
+/**
+ * Extracts visual features of each camera of a multi-camera SensorData in
+ * parallel (one Feature2D per camera), then sets them in the SensorData so
+ * that odometry doesn't extract them again on the combined image. Keypoints
+ * are in combined image coordinates and 3D keypoints in base frame.
+ */
+class FeatureExtractor
+{
+public:
+	// Odometry parameters, "Vis/" feature parameters are used.
+	FeatureExtractor(const rtabmap::ParametersMap & parameters);
+	virtual ~FeatureExtractor();
+
+	// Returns false if features could not be extracted.
+	bool extract(rtabmap::SensorData & data);
+
+	// Odometry approaches that can use features already extracted.
+	static bool isSupported(const rtabmap::ParametersMap & parameters);
+
+private:
+	rtabmap::ParametersMap featureParameters_;
+	bool depthAsMask_;
+	std::vector<rtabmap::Feature2D*> detectors_;
+};
+
+}
+
+#endif /* FEATUREEXTRACTOR_H_ */
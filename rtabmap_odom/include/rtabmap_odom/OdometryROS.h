@@ -46,8 +46,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UThread.h>
 
 #include <boost/thread.hpp>
+#include <list>
 
 #include "rtabmap_util/ULogToRosout.h"
+#include "rtabmap_util/ThreadScheduling.h"
 #include "rtabmap_sync/SyncDiagnostic.h"
 
 namespace rtabmap {
@@ -56,6 +58,8 @@ class Odometry;
 
 namespace rtabmap_odom {
 
+class SensorDataCompressor;
+
 class OdometryROS : public nodelet::Nodelet, public UThread
 {
 
@@ -63,7 +67,8 @@ public:
 	OdometryROS(bool stereoParams, bool visParams, bool icpParams);
 	virtual ~OdometryROS();
 
-	void processData(rtabmap::SensorData & data, const std_msgs::Header & header);
+	// arrival: time the callback received the data (now if not set)
+	void processData(rtabmap::SensorData & data, const std_msgs::Header & header, const ros::Time & arrival = ros::Time());
 
 	bool reset(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
 	bool resetToPose(rtabmap_msgs::ResetPose::Request&, rtabmap_msgs::ResetPose::Response&);
@@ -89,16 +94,25 @@ protected:
 	rtabmap::Transform velocityGuess() const;
 	double previousStamp() const {return previousStamp_;}
 	virtual void postProcessData(const rtabmap::SensorData & data, const std_msgs::Header & header) const {}
+	// Subclasses needing IMU data should return true (called after onOdomInit()),
+	// they will receive it through onIMU() from the single IMU subscriber.
+	virtual bool isIMURequired() const {return false;}
+	virtual void onIMU(double stamp, const rtabmap::IMU & imu) {}
+	const std::string & imuTopic() const {return imuSub_.getTopic();}
 
 private:
 	virtual void onInit();
 	virtual void onOdomInit() = 0;
 	virtual void updateParameters(rtabmap::ParametersMap & parameters) {}
 
+	virtual void mainLoopBegin();
 	virtual void mainLoop();
 	virtual void mainLoopKill();
 
 	void callbackIMU(const sensor_msgs::ImuConstPtr& msg);
+	void publishCompressedSensorData(rtabmap::SensorData & data, const std_msgs::Header & header);
+	void correctPrediction(const rtabmap::Transform & pose, double stamp, const cv::Mat & covariance);
+	void predict(double stamp, const cv::Vec3d & angularVelocity);
 	void reset(const rtabmap::Transform & pose = rtabmap::Transform::getIdentity());
 
 private:
@@ -130,6 +144,8 @@ private:
 	ros::Publisher odomSensorDataPub_;
 	ros::Publisher odomSensorDataFeaturesPub_;
 	ros::Publisher odomSensorDataCompressedPub_;
+	ros::Publisher odomPredictedPub_;
+	ros::Publisher odomLatencyPub_;
 	ros::ServiceServer resetSrv_;
 	ros::ServiceServer resetToPoseSrv_;
 	ros::ServiceServer pauseSrv_;
@@ -145,9 +161,20 @@ private:
 	// Safe-threading
 	UMutex imuMutex_;
 	UMutex dataMutex_;	
+	UMutex processMutex_;
 	USemaphore dataReady_;
-	rtabmap::SensorData dataToProcess_;
-	std_msgs::Header dataHeaderToProcess_;
+	// bounded queue between preprocessing (callbacks) and registration (mainLoop)
+	struct QueuedData
+	{
+		rtabmap::SensorData data;
+		std_msgs::Header header;
+		ros::Time arrival;
+		ros::Time queued;
+	};
+	std::list<QueuedData> dataQueue_;
+	int dataQueueMaxSize_;
+	unsigned long framesReceived_;
+	unsigned long framesDropped_;
 
 	bool paused_;
 	int resetCountdown_;
@@ -163,10 +190,39 @@ private:
 	double minUpdateRate_;
 	std::string compressionImgFormat_;
 	bool compressionParallelized_;
+	bool compressionAsync_;
+	bool compressionKeyFramesOnly_;
+	std::unique_ptr<SensorDataCompressor> compressor_;
+	bool packedFeatures_;
+	int odomInfoFields_;
+	int odomInfoLiteFields_;
 	int odomStrategy_;
 	bool waitIMUToinit_;
 	bool imuProcessed_;
 	std::map<double, rtabmap::IMU> imus_;
+	double imuAngularSpeed_; // norm of the last IMU angular velocity (rad/s)
+
+	// CPU budget: frames are skipped during slow motion when odometry
+	// processing time is over the budget (ratio of sensor period)
+	double cpuBudget_;
+	double cpuBudgetMaxLinearVel_;
+	double cpuBudgetMaxAngularVel_;
+	int cpuBudgetMaxSkippedFrames_;
+	double processingTimeAvg_;
+	double frameIntervalAvg_;
+	double lastFrameStamp_;
+	int consecutiveSkippedFrames_;
+	unsigned long framesSkipped_;
+
+	// Odometry predicted at IMU rate between registrations
+	bool publishPredictedOdom_;
+	bool publishPredictedTf_;
+	UMutex predictionMutex_;
+	rtabmap::Transform predictionPose_; // null if not initialized or lost
+	rtabmap::Transform predictionVelocity_;
+	cv::Mat predictionCovariance_;
+	double predictionStamp_;
+	std::map<double, cv::Vec3d> predictionImus_; // angular velocities (base frame) received after last registration
 
 	rtabmap_util::ULogToRosout ulogToRosout_;
 
@@ -175,12 +231,27 @@ private:
 	public:
 		OdomStatusTask();
 		void setStatus(bool isLost);
+		void setQueueStatus(unsigned long received, unsigned long dropped);
+		void setBudgetStatus(unsigned long skipped, double load);
+		void setCompressionStatus(unsigned long dropped);
+		// latencies (sec) of: sensor->arrival, preprocessing, queue wait, registration, publishing
+		void addLatency(double arrival, double preprocessing, double queue, double registration, double publishing);
 		void run(diagnostic_updater::DiagnosticStatusWrapper &stat);
 	private:
+		UMutex latencyMutex_;
+		std::vector<std::list<double> > latencies_; // last frames, one list per stage + total
 		bool lost_;
 		bool dataReceived_;
+		unsigned long framesReceived_;
+		unsigned long framesDropped_;
+		unsigned long framesSkipped_;
+		unsigned long compressionDropped_;
+		double load_;
 	};
 	OdomStatusTask statusDiagnostic_;
+	rtabmap_util::ThreadScheduling mainLoopScheduling_;
+	rtabmap_util::CallbackThreadsScheduling callbackThreadsScheduling_;
+	rtabmap_util::ThreadSchedulingTask threadSchedulingDiagnostic_;
 	std::unique_ptr<rtabmap_sync::SyncDiagnostic> syncDiagnostic_;
 };
 
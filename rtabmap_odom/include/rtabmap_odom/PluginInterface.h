@@ -25,8 +25,27 @@ public:
 
   void initialize(const std::string name, ros::NodeHandle & nh);
 
+  /** @brief Filter the cloud in place, updating the timing statistics.
+   * This is what the odometry calls for each enabled plugin of the chain.
+   **/
+  void filter(sensor_msgs::PointCloud2 & msg);
+
+  /** @brief Filter the cloud in place. The default implementation calls
+   * filterPointCloud() (one copy). Plugins filtering in place should
+   * derive from InPlacePluginInterface instead.
+   **/
+  virtual void filterPointCloudInPlace(sensor_msgs::PointCloud2 & msg);
+
+  /** @brief Returns a filtered copy of the cloud.
+   **/
   virtual sensor_msgs::PointCloud2 filterPointCloud(const sensor_msgs::PointCloud2 msg) = 0;
 
+  // Timing statistics of filter() (in seconds)
+  unsigned long calls() const {return calls_;}
+  double lastTime() const {return lastTime_;}
+  double meanTime() const {return calls_?totalTime_/double(calls_):0.0;}
+  double maxTime() const {return maxTime_;}
+
 protected:
   /** @brief This is called at the end of initialize().  Override to
    * implement subclass-specific initialization.
@@ -37,6 +56,23 @@ protected:
   std::string name_;
   ros::NodeHandle nh_;
 
+private:
+  unsigned long calls_;
+  double lastTime_;
+  double totalTime_;
+  double maxTime_;
+
+};
+
+/** @brief Base class of plugins filtering the cloud in place, only
+ * filterPointCloudInPlace() has to be implemented.
+ **/
+class InPlacePluginInterface : public PluginInterface
+{
+public:
+  virtual void filterPointCloudInPlace(sensor_msgs::PointCloud2 & msg) = 0;
+
+  virtual sensor_msgs::PointCloud2 filterPointCloud(const sensor_msgs::PointCloud2 msg);
 };
 
 }  // namespace rtabmap_odom
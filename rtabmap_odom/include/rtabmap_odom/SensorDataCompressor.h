@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef SENSORDATACOMPRESSOR_H_
+#define SENSORDATACOMPRESSOR_H_
+
+#include <std_msgs/Header.h>
+
+#include <rtabmap/core/SensorData.h>
+#include <rtabmap/utilite/UThread.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/USemaphore.h>
+
+#include <boost/function.hpp>
+
+namespace rtabmap_odom {
+
+/**
+ * Compresses image, depth/right image and laser scan of SensorData. The
+ * workers (one per stream) and the background thread are created once and
+ * reused for all frames.
+ */
+class SensorDataCompressor : public UThread
+{
+public:
+	typedef boost::function<void(rtabmap::SensorData &, const std_msgs::Header &)> Callback;
+
+public:
+	SensorDataCompressor(const std::string & imageFormat = ".jpg", bool parallel = true);
+	virtual ~SensorDataCompressor();
+
+	// Set compressed image, depth and scan in data (raw data are kept).
+	void compress(rtabmap::SensorData & data);
+
+	// Compress data on the background thread, then call callback from
+	// that thread. If a frame is still waiting to be compressed, it is
+	// replaced by this one. Returns false if a frame has been dropped.
+	bool compressAsync(const rtabmap::SensorData & data, const std_msgs::Header & header, const Callback & callback);
+
+	unsigned long framesDropped() const {return framesDropped_;}
+
+private:
+	virtual void mainLoop();
+	virtual void mainLoopKill();
+
+private:
+	class Worker : public UThread
+	{
+	public:
+		Worker(bool scan) : scan_(scan) {}
+		virtual ~Worker() {this->join(true);}
+		void post(const cv::Mat & input, const std::string & format);
+		cv::Mat wait();
+	private:
+		virtual void mainLoop();
+		virtual void mainLoopKill() {start_.release();}
+	private:
+		bool scan_;
+		cv::Mat input_;
+		std::string format_;
+		cv::Mat output_;
+		USemaphore start_;
+		USemaphore done_;
+	};
+
+	std::string imageFormat_;
+	bool parallel_;
+	Worker * imageWorker_;
+	Worker * depthWorker_;
+	Worker * scanWorker_;
+
+	UMutex pendingMutex_;
+	USemaphore pendingReady_;
+	bool pending_;
+	rtabmap::SensorData pendingData_;
+	std_msgs::Header pendingHeader_;
+	Callback pendingCallback_;
+	unsigned long framesDropped_;
+};
+
+}
+
+#endif /* SENSORDATACOMPRESSOR_H_ */
@@ -0,0 +1,183 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "rtabmap_odom/FeatureExtractor.h"
+
+#include <rtabmap/core/Features2d.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UConversion.h>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+
+using namespace rtabmap;
+
+namespace rtabmap_odom {
+
+FeatureExtractor::FeatureExtractor(const ParametersMap & parameters) :
+	featureParameters_(parameters),
+	depthAsMask_(Parameters::defaultVisDepthAsMask())
+{
+	// Same mapping as RegistrationVis for its feature detector
+	ParametersMap defaults = Parameters::getDefaultParameters();
+	const std::string visKeys[] = {
+			Parameters::kVisFeatureType(), Parameters::kVisMaxFeatures(), Parameters::kVisMaxDepth(), Parameters::kVisMinDepth(),
+			Parameters::kVisRoiRatios(), Parameters::kVisSubPixWinSize(), Parameters::kVisSubPixIterations(), Parameters::kVisSubPixEps(),
+			Parameters::kVisGridRows(), Parameters::kVisGridCols()};
+	const std::string kpKeys[] = {
+			Parameters::kKpDetectorStrategy(), Parameters::kKpMaxFeatures(), Parameters::kKpMaxDepth(), Parameters::kKpMinDepth(),
+			Parameters::kKpRoiRatios(), Parameters::kKpSubPixWinSize(), Parameters::kKpSubPixIterations(), Parameters::kKpSubPixEps(),
+			Parameters::kKpGridRows(), Parameters::kKpGridCols()};
+	for(int i=0; i<10; ++i)
+	{
+		ParametersMap::const_iterator iter = parameters.find(visKeys[i]);
+		uInsert(featureParameters_, ParametersPair(kpKeys[i], iter!=parameters.end()?iter->second:defaults.at(visKeys[i])));
+	}
+	Parameters::parse(parameters, Parameters::kVisDepthAsMask(), depthAsMask_);
+}
+
+FeatureExtractor::~FeatureExtractor()
+{
+	for(size_t i=0; i<detectors_.size(); ++i)
+	{
+		delete detectors_[i];
+	}
+}
+
+bool FeatureExtractor::isSupported(const ParametersMap & parameters)
+{
+	int odomStrategy = Parameters::defaultOdomStrategy();
+	int corType = Parameters::defaultVisCorType();
+	int decimation = Parameters::defaultOdomImageDecimation();
+	Parameters::parse(parameters, Parameters::kOdomStrategy(), odomStrategy);
+	Parameters::parse(parameters, Parameters::kVisCorType(), corType);
+	Parameters::parse(parameters, Parameters::kOdomImageDecimation(), decimation);
+	// Frame-to-Map and Frame-to-Frame with features matching
+	return (odomStrategy == 0 || odomStrategy == 1) && corType == 0 && decimation <= 1;
+}
+
+bool FeatureExtractor::extract(SensorData & data)
+{
+	bool stereo = !data.stereoCameraModels().empty();
+	int cameras = stereo?data.stereoCameraModels().size():data.cameraModels().size();
+	const cv::Mat & image = data.imageRaw();
+	const cv::Mat & depthOrRight = data.depthOrRightRaw();
+	if(cameras == 0 || image.empty() || depthOrRight.empty() ||
+	   !(image.type() == CV_8UC1 || image.type() == CV_8UC3) ||
+	   image.cols % cameras != 0 || depthOrRight.cols % cameras != 0)
+	{
+		return false;
+	}
+
+	if((int)detectors_.size() != cameras)
+	{
+		for(size_t i=0; i<detectors_.size(); ++i)
+		{
+			delete detectors_[i];
+		}
+		detectors_.clear();
+		// maximum features is shared between cameras
+		ParametersMap parameters = featureParameters_;
+		int maxFeatures = Parameters::defaultKpMaxFeatures();
+		Parameters::parse(parameters, Parameters::kKpMaxFeatures(), maxFeatures);
+		if(maxFeatures > 0)
+		{
+			uInsert(parameters, ParametersPair(Parameters::kKpMaxFeatures(), uNumber2Str(std::max(1, maxFeatures/cameras))));
+		}
+		for(int i=0; i<cameras; ++i)
+		{
+			detectors_.push_back(Feature2D::create(parameters));
+		}
+	}
+
+	int subImageWidth = image.cols/cameras;
+	int subDepthWidth = depthOrRight.cols/cameras;
+	std::vector<std::vector<cv::KeyPoint> > keypoints(cameras);
+	std::vector<std::vector<cv::Point3f> > keypoints3D(cameras);
+	std::vector<cv::Mat> descriptors(cameras);
+	cv::parallel_for_(cv::Range(0, cameras), [&](const cv::Range & range)
+	{
+		for(int i=range.start; i<range.end; ++i)
+		{
+			cv::Mat subImage(image, cv::Rect(i*subImageWidth, 0, subImageWidth, image.rows));
+			cv::Mat subDepthOrRight(depthOrRight, cv::Rect(i*subDepthWidth, 0, subDepthWidth, depthOrRight.rows));
+			cv::Mat gray;
+			if(subImage.channels() > 1)
+			{
+				cv::cvtColor(subImage, gray, cv::COLOR_BGR2GRAY);
+			}
+			else
+			{
+				gray = subImage;
+			}
+
+			cv::Mat mask;
+			if(!stereo && depthAsMask_ && subDepthOrRight.size() == gray.size())
+			{
+				mask = subDepthOrRight;
+			}
+			keypoints[i] = detectors_[i]->generateKeypoints(gray, mask);
+			descriptors[i] = detectors_[i]->generateDescriptors(gray, keypoints[i]);
+			SensorData cameraData = stereo?
+					SensorData(gray, subDepthOrRight, data.stereoCameraModels()[i]):
+					SensorData(gray, subDepthOrRight, data.cameraModels()[i]);
+			keypoints3D[i] = detectors_[i]->generateKeypoints3D(cameraData, keypoints[i]);
+		}
+	});
+
+	// merge with camera index encoded in keypoint position
+	std::vector<cv::KeyPoint> allKeypoints;
+	std::vector<cv::Point3f> allKeypoints3D;
+	std::vector<cv::Mat> allDescriptors;
+	for(int i=0; i<cameras; ++i)
+	{
+		UASSERT(keypoints[i].size() == keypoints3D[i].size() && (int)keypoints[i].size() == descriptors[i].rows);
+		for(size_t j=0; j<keypoints[i].size(); ++j)
+		{
+			keypoints[i][j].pt.x += i*subImageWidth;
+		}
+		allKeypoints.insert(allKeypoints.end(), keypoints[i].begin(), keypoints[i].end());
+		allKeypoints3D.insert(allKeypoints3D.end(), keypoints3D[i].begin(), keypoints3D[i].end());
+		if(!descriptors[i].empty())
+		{
+			allDescriptors.push_back(descriptors[i]);
+		}
+	}
+	cv::Mat allDescriptorsMat;
+	if(!allDescriptors.empty())
+	{
+		cv::vconcat(allDescriptors, allDescriptorsMat);
+	}
+	data.setFeatures(allKeypoints, allKeypoints3D, allDescriptorsMat);
+	return true;
+}
+
+}
@@ -42,15 +42,18 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/util3d_transforms.h>
 #include <rtabmap/core/Memory.h>
 #include <rtabmap/core/Signature.h>
-#include <rtabmap/core/Compression.h>
+#include "rtabmap_odom/SensorDataCompressor.h"
 #include "rtabmap_conversions/MsgConversion.h"
 #include "rtabmap_msgs/OdomInfo.h"
+#include "rtabmap_msgs/OdomLatency.h"
 #include "rtabmap/utilite/UConversion.h"
 #include "rtabmap/utilite/ULogger.h"
 #include "rtabmap/utilite/UStl.h"
 #include "rtabmap/utilite/UFile.h"
 #include "rtabmap/utilite/UMath.h"
 
+#include <algorithm>
+
 #define BAD_COVARIANCE 9999
 
 using namespace rtabmap;
@@ -72,6 +75,9 @@ OdometryROS::OdometryROS(bool stereoParams, bool visParams, bool icpParams) :
 	waitForTransformDuration_(0.1), // 100 ms
 	publishNullWhenLost_(true),
 	publishCompressedSensorData_(false),
+	dataQueueMaxSize_(1),
+	framesReceived_(0),
+	framesDropped_(0),
 	paused_(false),
 	resetCountdown_(0),
 	resetCurrentCount_(0),
@@ -84,9 +90,27 @@ OdometryROS::OdometryROS(bool stereoParams, bool visParams, bool icpParams) :
 	minUpdateRate_(0.0),
 	compressionImgFormat_(".jpg"),
 	compressionParallelized_(true),
+	compressionAsync_(false),
+	compressionKeyFramesOnly_(false),
+	packedFeatures_(false),
+	odomInfoFields_(rtabmap_conversions::kOdomInfoAll),
+	odomInfoLiteFields_(rtabmap_conversions::kOdomInfoLocalBundle), // same fields as before masks were added
 	odomStrategy_(Parameters::defaultOdomStrategy()),
 	waitIMUToinit_(false),
-	imuProcessed_(false)
+	imuProcessed_(false),
+	imuAngularSpeed_(-1.0),
+	cpuBudget_(0.0),
+	cpuBudgetMaxLinearVel_(0.1),
+	cpuBudgetMaxAngularVel_(0.1),
+	cpuBudgetMaxSkippedFrames_(3),
+	processingTimeAvg_(0.0),
+	frameIntervalAvg_(0.0),
+	lastFrameStamp_(0.0),
+	consecutiveSkippedFrames_(0),
+	framesSkipped_(0),
+	publishPredictedOdom_(false),
+	publishPredictedTf_(false),
+	predictionStamp_(0.0)
 {
 
 }
@@ -94,6 +118,7 @@ OdometryROS::OdometryROS(bool stereoParams, bool visParams, bool icpParams) :
 OdometryROS::~OdometryROS()
 {
 	this->join(true);
+	compressor_.reset();
 	delete odometry_;
 }
 
@@ -112,6 +137,7 @@ void OdometryROS::onInit()
 	odomSensorDataPub_ = nh.advertise<rtabmap_msgs::SensorData>("odom_sensor_data/raw", 1);
 	odomSensorDataFeaturesPub_ = nh.advertise<rtabmap_msgs::SensorData>("odom_sensor_data/features", 1);
 	odomSensorDataCompressedPub_ = nh.advertise<rtabmap_msgs::SensorData>("odom_sensor_data/compressed", 1);
+	odomLatencyPub_ = nh.advertise<rtabmap_msgs::OdomLatency>("odom_latency", 10);
 
 	Transform initialPose = Transform::getIdentity();
 	std::string initialPoseStr;
@@ -149,17 +175,48 @@ void OdometryROS::onInit()
 	pnh.param("expected_update_rate", expectedUpdateRate_, expectedUpdateRate_); // expected sensor rate
 	pnh.param("max_update_rate", maxUpdateRate_, maxUpdateRate_);
 	pnh.param("min_update_rate", minUpdateRate_, minUpdateRate_);
+	pnh.param("cpu_budget", cpuBudget_, cpuBudget_);
+	mainLoopScheduling_ = rtabmap_util::ThreadScheduling("rtabmap_odom");
+	mainLoopScheduling_.load(pnh, "odom_thread");
+	callbackThreadsScheduling_.load(pnh, "callback_threads", &threadSchedulingDiagnostic_);
+	pnh.param("cpu_budget_max_linear_vel", cpuBudgetMaxLinearVel_, cpuBudgetMaxLinearVel_);
+	pnh.param("cpu_budget_max_angular_vel", cpuBudgetMaxAngularVel_, cpuBudgetMaxAngularVel_);
+	pnh.param("cpu_budget_max_skipped_frames", cpuBudgetMaxSkippedFrames_, cpuBudgetMaxSkippedFrames_);
 
 	pnh.param("sensor_data_compression_format", compressionImgFormat_, compressionImgFormat_);
 	pnh.param("sensor_data_parallel_compression", compressionParallelized_, compressionParallelized_);
+	pnh.param("sensor_data_async_compression", compressionAsync_, compressionAsync_);
+	pnh.param("sensor_data_compression_key_frames_only", compressionKeyFramesOnly_, compressionKeyFramesOnly_);
+	pnh.param("packed_features", packedFeatures_, packedFeatures_);
+	pnh.param("odom_info_fields", odomInfoFields_, odomInfoFields_);
+	pnh.param("odom_info_lite_fields", odomInfoLiteFields_, odomInfoLiteFields_);
 
 	pnh.param("wait_imu_to_init", waitIMUToinit_, waitIMUToinit_);
+	pnh.param("processing_queue_size", dataQueueMaxSize_, dataQueueMaxSize_);
+	pnh.param("publish_predicted_odom", publishPredictedOdom_, publishPredictedOdom_);
+	pnh.param("publish_predicted_tf", publishPredictedTf_, publishPredictedTf_);
+	if(dataQueueMaxSize_ < 1)
+	{
+		NODELET_WARN("Parameter \"processing_queue_size\" should be >= 1, setting it to 1.");
+		dataQueueMaxSize_ = 1;
+	}
 
 	int eventLevel = ULogger::kFatal;
 	pnh.param("log_to_rosout_level", eventLevel, eventLevel);
 	UASSERT(eventLevel >= ULogger::kDebug && eventLevel <= ULogger::kFatal);
 	ULogger::setEventLevel((ULogger::Level)eventLevel);
 
+	if(publishPredictedTf_ && (!publishPredictedOdom_ || !publishTf_ || !guessFrameId_.empty()))
+	{
+		NODELET_WARN("\"publish_predicted_tf\" requires \"publish_predicted_odom\" and \"publish_tf\" "
+				"to be true and \"guess_frame_id\" to be empty, predicted TF is disabled.");
+		publishPredictedTf_ = false;
+	}
+	else if(publishPredictedTf_)
+	{
+		NODELET_INFO("Odometry: \"publish_predicted_tf\" is enabled, %s->%s TF is also published at IMU rate "
+				"from the prediction between registrations.", odomFrameId_.c_str(), frameId_.c_str());
+	}
 	if(publishTf_ && !guessFrameId_.empty() && guessFrameId_.compare(odomFrameId_) == 0)
 	{
 		NODELET_WARN( "\"publish_tf\" and \"guess_frame_id\" cannot be used "
@@ -186,9 +243,25 @@ void OdometryROS::onInit()
 	NODELET_INFO("Odometry: expected_update_rate   = %f Hz", expectedUpdateRate_);
 	NODELET_INFO("Odometry: max_update_rate        = %f Hz", maxUpdateRate_);
 	NODELET_INFO("Odometry: min_update_rate        = %f Hz", minUpdateRate_);
+	NODELET_INFO("Odometry: cpu_budget             = %f", cpuBudget_);
+	if(cpuBudget_ > 0.0)
+	{
+		NODELET_INFO("Odometry: cpu_budget_max_linear_vel  = %f m/s", cpuBudgetMaxLinearVel_);
+		NODELET_INFO("Odometry: cpu_budget_max_angular_vel = %f rad/s", cpuBudgetMaxAngularVel_);
+		NODELET_INFO("Odometry: cpu_budget_max_skipped_frames = %d", cpuBudgetMaxSkippedFrames_);
+	}
 	NODELET_INFO("Odometry: wait_imu_to_init       = %s", waitIMUToinit_?"true":"false");
+	NODELET_INFO("Odometry: processing_queue_size  = %d", dataQueueMaxSize_);
+	NODELET_INFO("Odometry: publish_predicted_odom = %s", publishPredictedOdom_?"true":"false");
+	NODELET_INFO("Odometry: publish_predicted_tf   = %s", publishPredictedTf_?"true":"false");
 	NODELET_INFO("Odometry: sensor_data_compression_format   = %s", compressionImgFormat_.c_str());
 	NODELET_INFO("Odometry: sensor_data_parallel_compression = %s", compressionParallelized_?"true":"false");
+	NODELET_INFO("Odometry: sensor_data_async_compression    = %s", compressionAsync_?"true":"false");
+	NODELET_INFO("Odometry: sensor_data_compression_key_frames_only = %s", compressionKeyFramesOnly_?"true":"false");
+	NODELET_INFO("Odometry: packed_features        = %s", packedFeatures_?"true":"false");
+	// 1=words, 2=word matches, 4=corners, 8=local map, 16=local scan map, 32=local bundle
+	NODELET_INFO("Odometry: odom_info_fields       = %d", odomInfoFields_);
+	NODELET_INFO("Odometry: odom_info_lite_fields  = %d", odomInfoLiteFields_);
 
 	configPath = uReplaceChar(configPath, '~', UDirectory::homeDir());
 	if(configPath.size() && configPath.at(0) != '/')
@@ -372,17 +445,26 @@ void OdometryROS::onInit()
 
 	odomStrategy_ = 0;
 	Parameters::parse(this->parameters(), Parameters::kOdomStrategy(), odomStrategy_);
-	if(waitIMUToinit_)
+	if(publishPredictedOdom_)
 	{
-		int queueSize = 10;
-		pnh.param("queue_size", queueSize, queueSize);
-		imuSub_ = nh.subscribe("imu", queueSize*5, &OdometryROS::callbackIMU, this);
-		NODELET_INFO("odometry: Subscribing to IMU topic %s", imuSub_.getTopic().c_str());
+		odomPredictedPub_ = nh.advertise<nav_msgs::Odometry>("odom_predicted", 10);
 	}
 
+	compressor_.reset(new SensorDataCompressor(compressionImgFormat_, compressionParallelized_));
+
 	this->start();
 
 	onOdomInit();
+
+	// After onOdomInit() so that subclasses can request IMU data
+	if(waitIMUToinit_ || publishPredictedOdom_ || isIMURequired())
+	{
+		int queueSize = 10;
+		pnh.param("queue_size", queueSize, queueSize);
+		// all samples are needed by subclasses (e.g., deskewing)
+		imuSub_ = nh.subscribe("imu", queueSize*(isIMURequired()?100:5), &OdometryROS::callbackIMU, this);
+		NODELET_INFO("odometry: Subscribing to IMU topic %s", imuSub_.getTopic().c_str());
+	}
 }
 
 void OdometryROS::initDiagnosticMsg(const std::string & subscribedTopicsMsg, bool approxSync, const std::string & subscribedTopic)
@@ -391,6 +473,7 @@ void OdometryROS::initDiagnosticMsg(const std::string & subscribedTopicsMsg, boo
 	syncDiagnostic_.reset(new rtabmap_sync::SyncDiagnostic(getNodeHandle(), getPrivateNodeHandle(), getName(), 0.5));
 	std::vector<diagnostic_updater::DiagnosticTask*> tasks;
 	tasks.push_back(&statusDiagnostic_);
+	tasks.push_back(&threadSchedulingDiagnostic_);
 	syncDiagnostic_->init(subscribedTopic,
 		uFormat("%s: Did not receive data since 5 seconds! Make sure the input topics are "
 					"published (\"$ rostopic hz my_topic\") and the timestamps in their "
@@ -413,6 +496,7 @@ rtabmap::Transform OdometryROS::velocityGuess() const
 
 void OdometryROS::callbackIMU(const sensor_msgs::ImuConstPtr& msg)
 {
+	callbackThreadsScheduling_.applyToCurrentThread();
 	if(!this->isPaused())
 	{
 		double stamp = msg->header.stamp.toSec();
@@ -436,6 +520,25 @@ void OdometryROS::callbackIMU(const sensor_msgs::ImuConstPtr& msg)
 				cv::Mat(3,3,CV_64FC1,(void*)msg->linear_acceleration_covariance.data()).clone(),
 				localTransform);
 
+		imuAngularSpeed_ = std::sqrt(
+				msg->angular_velocity.x*msg->angular_velocity.x +
+				msg->angular_velocity.y*msg->angular_velocity.y +
+				msg->angular_velocity.z*msg->angular_velocity.z);
+
+		onIMU(stamp, imu);
+
+		if(publishPredictedOdom_)
+		{
+			Eigen::Vector3d w = localTransform.toEigen3d().linear() * Eigen::Vector3d(msg->angular_velocity.x, msg->angular_velocity.y, msg->angular_velocity.z);
+			predict(stamp, cv::Vec3d(w[0], w[1], w[2]));
+		}
+
+		if(!waitIMUToinit_)
+		{
+			// only subscribed for prediction
+			return;
+		}
+
 		UScopeMutex m(imuMutex_);
 
 		imus_.insert(std::make_pair(stamp, imu));
@@ -447,20 +550,135 @@ void OdometryROS::callbackIMU(const sensor_msgs::ImuConstPtr& msg)
 	}
 }
 
-void OdometryROS::processData(SensorData & data, const std_msgs::Header & header)
+void OdometryROS::correctPrediction(const Transform & pose, double stamp, const cv::Mat & covariance)
 {
+	UScopeMutex lock(predictionMutex_);
+	predictionPose_ = pose;
+	if(pose.isNull())
+	{
+		// lost, stop predicting until next registration
+		predictionImus_.clear();
+		return;
+	}
+	predictionVelocity_ = odometry_->getVelocityGuess();
+	predictionCovariance_ = covariance.clone();
+	predictionStamp_ = stamp;
+
+	// Re-integrate angular velocities received since the registered frame
+	std::map<double, cv::Vec3d> imus;
+	imus.swap(predictionImus_);
+	for(std::map<double, cv::Vec3d>::iterator iter=imus.upper_bound(stamp); iter!=imus.end(); ++iter)
+	{
+		float vx=0,vy=0,vz=0;
+		if(!predictionVelocity_.isNull())
+		{
+			predictionVelocity_.getTranslation(vx,vy,vz);
+		}
+		double dt = iter->first - predictionStamp_;
+		predictionPose_ *= Transform(vx*dt, vy*dt, vz*dt, iter->second[0]*dt, iter->second[1]*dt, iter->second[2]*dt);
+		predictionStamp_ = iter->first;
+		predictionImus_.insert(*iter);
+	}
+}
+
+void OdometryROS::predict(double stamp, const cv::Vec3d & angularVelocity)
+{
+	// Constant linear velocity from the last registration, rotation from the gyroscope
+	UScopeMutex lock(predictionMutex_);
+	// predictionStamp_ is never before the last registered stamp (see
+	// correctPrediction()), so predicted TF doesn't overwrite registered poses
+	if(predictionPose_.isNull() || stamp <= predictionStamp_)
+	{
+		return;
+	}
+	predictionImus_.insert(std::make_pair(stamp, angularVelocity));
+
+	float vx=0,vy=0,vz=0;
+	if(!predictionVelocity_.isNull())
+	{
+		predictionVelocity_.getTranslation(vx,vy,vz);
+	}
+	double dt = stamp - predictionStamp_;
+	predictionPose_ *= Transform(vx*dt, vy*dt, vz*dt, angularVelocity[0]*dt, angularVelocity[1]*dt, angularVelocity[2]*dt);
+	predictionStamp_ = stamp;
+
+	geometry_msgs::TransformStamped poseMsg;
+	poseMsg.child_frame_id = frameId_;
+	poseMsg.header.frame_id = odomFrameId_;
+	poseMsg.header.stamp.fromSec(stamp);
+	rtabmap_conversions::transformToGeometryMsg(predictionPose_, poseMsg.transform);
+
+	if(publishPredictedTf_)
+	{
+		tfBroadcaster_.sendTransform(poseMsg);
+	}
+
+	if(odomPredictedPub_.getNumSubscribers())
+	{
+		nav_msgs::OdometryPtr odom(new nav_msgs::Odometry);
+		odom->header = poseMsg.header;
+		odom->child_frame_id = frameId_;
+		odom->pose.pose.position.x = poseMsg.transform.translation.x;
+		odom->pose.pose.position.y = poseMsg.transform.translation.y;
+		odom->pose.pose.position.z = poseMsg.transform.translation.z;
+		odom->pose.pose.orientation = poseMsg.transform.rotation;
+		odom->twist.twist.linear.x = vx;
+		odom->twist.twist.linear.y = vy;
+		odom->twist.twist.linear.z = vz;
+		odom->twist.twist.angular.x = angularVelocity[0];
+		odom->twist.twist.angular.y = angularVelocity[1];
+		odom->twist.twist.angular.z = angularVelocity[2];
+		if(predictionCovariance_.rows == 6 && predictionCovariance_.cols == 6)
+		{
+			for(int i=0; i<6; ++i)
+			{
+				odom->pose.covariance.at(i*7) = predictionCovariance_.at<double>(i,i)*2;
+				odom->twist.covariance.at(i*7) = predictionCovariance_.at<double>(i,i);
+			}
+		}
+		odomPredictedPub_.publish(odom);
+	}
+}
+
+void OdometryROS::processData(SensorData & data, const std_msgs::Header & header, const ros::Time & arrival)
+{
+	callbackThreadsScheduling_.applyToCurrentThread();
 	//NODELET_WARN("Received image: %f delay=%f", data.stamp(), (ros::Time::now() - header.stamp).toSec());
-	if(dataMutex_.lockTry() == 0)
+	// Data are preprocessed by the callbacks while mainLoop() is registering
+	// the previous frame. If the queue is full, the oldest frame is dropped.
+	UScopeMutex lock(dataMutex_);
+	++framesReceived_;
+	if((int)dataQueue_.size() >= dataQueueMaxSize_)
 	{
-		dataToProcess_ = data;
-		dataHeaderToProcess_ = header;
-		dataReady_.release();
-		dataMutex_.unlock();
+		NODELET_DEBUG("Dropping image/scan data (stamp=%f)", dataQueue_.front().header.stamp.toSec());
+		dataQueue_.pop_front();
+		++framesDropped_;
 	}
 	else
 	{
-		NODELET_DEBUG("Dropping image/scan data");
+		dataReady_.release();
 	}
+	QueuedData queuedData;
+	queuedData.data = data;
+	queuedData.header = header;
+	queuedData.queued = ros::Time::now();
+	queuedData.arrival = arrival.isZero()?queuedData.queued:arrival;
+	dataQueue_.push_back(queuedData);
+}
+
+void OdometryROS::publishCompressedSensorData(SensorData & data, const std_msgs::Header & header)
+{
+	rtabmap_msgs::SensorDataPtr msg(new rtabmap_msgs::SensorData);
+	rtabmap_conversions::sensorDataToROS(data, *msg, frameId_, false, packedFeatures_);
+	msg->header.stamp = header.stamp; // use corresponding time stamp to image
+	odomSensorDataCompressedPub_.publish(msg);
+}
+
+void OdometryROS::mainLoopBegin()
+{
+	std::string status = mainLoopScheduling_.apply();
+	NODELET_INFO("Odometry: main loop thread scheduling: %s", status.c_str());
+	threadSchedulingDiagnostic_.setStatus("Odometry thread", status);
 }
 
 void OdometryROS::mainLoopKill()
@@ -479,11 +697,26 @@ void OdometryROS::mainLoop()
 		return;
 	}
 
-	UScopeMutex lock(dataMutex_);
+	SensorData data;
+	std_msgs::Header header;
+	rtabmap_msgs::OdomLatency latency;
+	{
+		UScopeMutex lock(dataMutex_);
+		if(dataQueue_.empty())
+		{
+			// queue cleared by reset
+			return;
+		}
+		data = dataQueue_.front().data;
+		header = dataQueue_.front().header;
+		latency.arrival = dataQueue_.front().arrival;
+		latency.queued = dataQueue_.front().queued;
+		latency.dequeued = ros::Time::now();
+		dataQueue_.pop_front();
+		statusDiagnostic_.setQueueStatus(framesReceived_, framesDropped_);
+	}
 
-	// aliases
-	SensorData & data = dataToProcess_;
-	std_msgs::Header & header = dataHeaderToProcess_;
+	UScopeMutex lock(processMutex_);
 
 	std::vector<std::pair<double, IMU> > imus;
 	{
@@ -643,6 +876,68 @@ void OdometryROS::mainLoop()
 
 	bool tooOldPreviousData = minUpdateRate_ > 0 && previousStamp_ > 0 && (header.stamp.toSec()-previousStamp_) > 1.0/minUpdateRate_;
 
+	// CPU budget
+	if(lastFrameStamp_ > 0.0 && header.stamp.toSec() > lastFrameStamp_)
+	{
+		double interval = header.stamp.toSec() - lastFrameStamp_;
+		frameIntervalAvg_ = frameIntervalAvg_ == 0.0?interval:0.9*frameIntervalAvg_ + 0.1*interval;
+	}
+	lastFrameStamp_ = header.stamp.toSec();
+	// Don't skip if the next frame would be too old for min_update_rate (odometry would be reset)
+	bool nextFrameTooOld = minUpdateRate_ > 0 && previousStamp_ > 0 &&
+			(header.stamp.toSec() - previousStamp_ + frameIntervalAvg_) > 1.0/minUpdateRate_;
+	if(cpuBudget_ > 0.0 && !tooOldPreviousData && !nextFrameTooOld && previousStamp_ > 0.0 && frameIntervalAvg_ > 0.0 &&
+	   processingTimeAvg_/frameIntervalAvg_ > cpuBudget_ &&
+	   consecutiveSkippedFrames_ < cpuBudgetMaxSkippedFrames_)
+	{
+		// Estimate motion from the velocity, the guess and the IMU. Never
+		// skip if unknown or too fast.
+		Transform velocity = odometry_->getVelocityGuess();
+		float linearVel = -1.0f;
+		float angularVel = -1.0f;
+		if(!velocity.isNull())
+		{
+			float x,y,z,roll,pitch,yaw;
+			velocity.getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+			linearVel = std::sqrt(x*x + y*y + z*z);
+			angularVel = std::sqrt(roll*roll + pitch*pitch + yaw*yaw);
+		}
+		double dt = header.stamp.toSec() - previousStamp_;
+		if(!guess_.isNull() && dt > 0.0)
+		{
+			float x,y,z,roll,pitch,yaw;
+			guess_.getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+			linearVel = std::max(linearVel, float(std::sqrt(x*x + y*y + z*z)/dt));
+			angularVel = std::max(angularVel, float(std::sqrt(roll*roll + pitch*pitch + yaw*yaw)/dt));
+		}
+		if(imuAngularSpeed_ >= 0.0)
+		{
+			angularVel = std::max(angularVel, float(imuAngularSpeed_));
+		}
+		if(linearVel >= 0.0f && angularVel >= 0.0f &&
+		   linearVel < cpuBudgetMaxLinearVel_ && angularVel < cpuBudgetMaxAngularVel_)
+		{
+			NODELET_DEBUG("Odometry: skipping frame (stamp=%f load=%f vel=%fm/s %frad/s)",
+					header.stamp.toSec(), processingTimeAvg_/frameIntervalAvg_, linearVel, angularVel);
+			++consecutiveSkippedFrames_;
+			++framesSkipped_;
+			processingTimeAvg_ *= 0.9; // skipped frame doesn't use CPU
+			statusDiagnostic_.setBudgetStatus(framesSkipped_, processingTimeAvg_/frameIntervalAvg_);
+			if(publishTf_ && !guessFrameId_.empty() && !guess_.isNull())
+			{
+				geometry_msgs::TransformStamped correctionMsg;
+				correctionMsg.child_frame_id = guessFrameId_;
+				correctionMsg.header.frame_id = odomFrameId_;
+				correctionMsg.header.stamp = header.stamp;
+				Transform correction = odometry_->getPose() * guess_ * guessCurrentPose.inverse();
+				rtabmap_conversions::transformToGeometryMsg(correction, correctionMsg.transform);
+				tfBroadcaster_.sendTransform(correctionMsg);
+			}
+			return;
+		}
+	}
+	consecutiveSkippedFrames_ = 0;
+
 	// process data
 	ros::WallTime time = ros::WallTime::now();
 	rtabmap::OdometryInfo info;
@@ -655,6 +950,11 @@ void OdometryROS::mainLoop()
 	{
 		pose = odometry_->process(data, guess_, &info);
 	}
+	latency.registered = ros::Time::now();
+	if(publishPredictedOdom_)
+	{
+		correctPrediction(pose, header.stamp.toSec(), info.reg.covariance);
+	}
 	if(!pose.isNull())
 	{
 		guess_.setNull();
@@ -684,6 +984,9 @@ void OdometryROS::mainLoop()
 			}
 			else
 			{
+				// Always sent, also with predicted TF, so that lookups at sensor
+				// stamps get the registered pose. predict() only publishes
+				// stamps after this one.
 				tfBroadcaster_.sendTransform(poseMsg);
 			}
 		}
@@ -880,6 +1183,26 @@ void OdometryROS::mainLoop()
 		}
 	}
 
+	latency.published = ros::Time::now();
+	double processingTime = (ros::WallTime::now()-time).toSec();
+	processingTimeAvg_ = processingTimeAvg_ == 0.0?processingTime:0.9*processingTimeAvg_ + 0.1*processingTime;
+	if(frameIntervalAvg_ > 0.0)
+	{
+		statusDiagnostic_.setBudgetStatus(framesSkipped_, processingTimeAvg_/frameIntervalAvg_);
+	}
+	latency.header.stamp = header.stamp;
+	latency.header.frame_id = odomFrameId_;
+	statusDiagnostic_.addLatency(
+			(latency.arrival - header.stamp).toSec(),
+			(latency.queued - latency.arrival).toSec(),
+			(latency.dequeued - latency.queued).toSec(),
+			(latency.registered - latency.dequeued).toSec(),
+			(latency.published - latency.registered).toSec());
+	if(odomLatencyPub_.getNumSubscribers())
+	{
+		odomLatencyPub_.publish(latency);
+	}
+
 	if(pose.isNull() && (resetCurrentCount_ > 0 || tooOldPreviousData))
 	{
 		if(tooOldPreviousData)
@@ -922,30 +1245,22 @@ void OdometryROS::mainLoop()
 		}
 	}
 
-	if(odomInfoPub_.getNumSubscribers() || odomInfoLitePub_.getNumSubscribers())
+	// Each publisher gets only the data fields it is configured for
+	if(odomInfoPub_.getNumSubscribers())
 	{
-		rtabmap_msgs::OdomInfo infoMsg;
-		rtabmap_conversions::odomInfoToROS(info, infoMsg, odomInfoPub_.getNumSubscribers()==0);
-		infoMsg.header.stamp = header.stamp; // use corresponding time stamp to image
-		infoMsg.header.frame_id = odomFrameId_;
-		if(odomInfoPub_.getNumSubscribers()>0) {
-			odomInfoPub_.publish(infoMsg);
-		}
-
-		if(odomInfoLitePub_.getNumSubscribers()>0)
-		{
-			infoMsg.wordInliers.clear();
-			infoMsg.wordMatches.clear();
-			infoMsg.wordsKeys.clear();
-			infoMsg.wordsValues.clear();
-			infoMsg.refCorners.clear();
-			infoMsg.newCorners.clear();
-			infoMsg.cornerInliers.clear();
-			infoMsg.localMapKeys.clear();
-			infoMsg.localMapValues.clear();
-			infoMsg.localScanMap = sensor_msgs::PointCloud2();
-			odomInfoLitePub_.publish(infoMsg);
-		}
+		rtabmap_msgs::OdomInfoPtr infoMsg(new rtabmap_msgs::OdomInfo);
+		rtabmap_conversions::odomInfoToROS(info, *infoMsg, odomInfoFields_, packedFeatures_);
+		infoMsg->header.stamp = header.stamp; // use corresponding time stamp to image
+		infoMsg->header.frame_id = odomFrameId_;
+		odomInfoPub_.publish(infoMsg);
+	}
+	if(odomInfoLitePub_.getNumSubscribers())
+	{
+		rtabmap_msgs::OdomInfoPtr infoMsg(new rtabmap_msgs::OdomInfo);
+		rtabmap_conversions::odomInfoToROS(info, *infoMsg, odomInfoLiteFields_, packedFeatures_);
+		infoMsg->header.stamp = header.stamp; // use corresponding time stamp to image
+		infoMsg->header.frame_id = odomFrameId_;
+		odomInfoLitePub_.publish(infoMsg);
 	}
 
 	postProcessData(data, header);
@@ -965,92 +1280,41 @@ void OdometryROS::mainLoop()
 		}
 	}
 
-	if(odomSensorDataPub_.getNumSubscribers() || odomSensorDataFeaturesPub_.getNumSubscribers())
+	// Messages are published by pointer so that they are not copied for intra-process subscribers
+	if(odomSensorDataPub_.getNumSubscribers())
 	{
-		rtabmap_msgs::SensorData msg;
-		rtabmap_conversions::sensorDataToROS(data, msg, frameId_, odomSensorDataPub_.getNumSubscribers());
-		msg.header.stamp = header.stamp; // use corresponding time stamp to image
-		if(odomSensorDataPub_.getNumSubscribers())
-		{
-			odomSensorDataPub_.publish(msg);
-		}
-		if(odomSensorDataFeaturesPub_.getNumSubscribers())
-		{
-			// remove data
-			msg.left = sensor_msgs::Image();
-			msg.right = sensor_msgs::Image();
-			msg.laser_scan = sensor_msgs::PointCloud2();
-			msg.grid_ground.clear();
-			msg.grid_obstacles.clear();
-			msg.grid_empty_cells.clear();
-			odomSensorDataFeaturesPub_.publish(msg);
-		}
+		rtabmap_msgs::SensorDataPtr msg(new rtabmap_msgs::SensorData);
+		rtabmap_conversions::sensorDataToROS(data, *msg, frameId_, true, packedFeatures_);
+		msg->header.stamp = header.stamp; // use corresponding time stamp to image
+		odomSensorDataPub_.publish(msg);
 	}
-	if(odomSensorDataCompressedPub_.getNumSubscribers())
+	if(odomSensorDataFeaturesPub_.getNumSubscribers())
 	{
-		cv::Mat compressedImage;
-		cv::Mat compressedDepth;
-		cv::Mat compressedScan;
-		if(compressionParallelized_)
+		rtabmap_msgs::SensorDataPtr msg(new rtabmap_msgs::SensorData);
+		rtabmap_conversions::sensorDataToROS(data, *msg, frameId_, false, packedFeatures_);
+		msg->header.stamp = header.stamp; // use corresponding time stamp to image
+		// remove data
+		msg->grid_ground.clear();
+		msg->grid_obstacles.clear();
+		msg->grid_empty_cells.clear();
+		odomSensorDataFeaturesPub_.publish(msg);
+	}
+	if(odomSensorDataCompressedPub_.getNumSubscribers() && (!compressionKeyFramesOnly_ || info.keyFrameAdded))
+	{
+		if(compressionAsync_)
 		{
-			rtabmap::CompressionThread ctImage(data.imageRaw(), compressionImgFormat_);
-			rtabmap::CompressionThread ctDepth(data.depthOrRightRaw(), data.depthOrRightRaw().type() == CV_32FC1 || data.depthOrRightRaw().type() == CV_16UC1?std::string(".png"):compressionImgFormat_);
-			rtabmap::CompressionThread ctLaserScan(data.laserScanRaw().data());
-			if(!data.imageRaw().empty())
+			// compressed after odometry is published, without delaying the next frame
+			if(!compressor_->compressAsync(data, header, boost::bind(&OdometryROS::publishCompressedSensorData, this, _1, _2)))
 			{
-				ctImage.start();
+				NODELET_DEBUG("Compression of previous sensor data not finished, it is skipped (stamp=%f)", header.stamp.toSec());
+				statusDiagnostic_.setCompressionStatus(compressor_->framesDropped());
 			}
-			if(!data.depthOrRightRaw().empty())
-			{
-				ctDepth.start();
-			}
-			if(!data.laserScanRaw().isEmpty())
-			{
-				ctLaserScan.start();
-			}
-			ctImage.join();
-			ctDepth.join();
-			ctLaserScan.join();
-
-			compressedImage = ctImage.getCompressedData();
-			compressedDepth = ctDepth.getCompressedData();
-			compressedScan = ctLaserScan.getCompressedData();
 		}
 		else
 		{
-			compressedImage = compressImage2(data.imageRaw(), compressionImgFormat_);
-			compressedDepth = compressImage2(data.depthOrRightRaw(), data.depthOrRightRaw().type() == CV_32FC1 || data.depthOrRightRaw().type() == CV_16UC1?std::string(".png"):compressionImgFormat_);
-			compressedScan = compressData2(data.laserScanRaw().data());
+			compressor_->compress(data);
+			publishCompressedSensorData(data, header);
 		}
-		if(!compressedImage.empty() && !data.stereoCameraModels().empty())
-		{
-			data.setStereoImage(compressedImage, compressedDepth, data.stereoCameraModels(), false);
-		}
-		else if(!compressedImage.empty() && !data.cameraModels().empty())
-		{
-			data.setRGBDImage(compressedImage, compressedDepth, data.cameraModels(), false);
-		}
-		if(!compressedScan.empty())
-		{
-			data.setLaserScan(data.laserScanRaw().angleIncrement() == 0.0f?
-						LaserScan(compressedScan,
-							data.laserScanRaw().maxPoints(),
-							data.laserScanRaw().rangeMax(),
-							data.laserScanRaw().format(),
-							data.laserScanRaw().localTransform()):
-						LaserScan(compressedScan,
-							data.laserScanRaw().format(),
-							data.laserScanRaw().rangeMin(),
-							data.laserScanRaw().rangeMax(),
-							data.laserScanRaw().angleMin(),
-							data.laserScanRaw().angleMax(),
-							data.laserScanRaw().angleIncrement(),
-							data.laserScanRaw().localTransform()), false);
-		}
-		rtabmap_msgs::SensorData msg;
-		rtabmap_conversions::sensorDataToROS(data, msg, frameId_, false);
-		msg.header.stamp = header.stamp; // use corresponding time stamp to image
-		odomSensorDataCompressedPub_.publish(msg);
 	}
 
 	double delay = (ros::Time::now() - header.stamp).toSec(); 
@@ -1100,18 +1364,24 @@ bool OdometryROS::resetToPose(rtabmap_msgs::ResetPose::Request& req, rtabmap_msg
 
 void OdometryROS::reset(const Transform & pose)
 {
-	UScopeMutex lock(dataMutex_);
+	UScopeMutex lock(processMutex_);
+	UScopeMutex lockData(dataMutex_);
 	odometry_->reset(pose);
 	guess_.setNull();
 	guessPreviousPose_.setNull();
 	previousStamp_ = 0.0;
 	resetCurrentCount_ = resetCountdown_;
 	imuProcessed_ = false;
-	dataToProcess_ = SensorData();
-	dataHeaderToProcess_ = std_msgs::Header();
+	dataQueue_.clear();
 	imuMutex_.lock();
 	imus_.clear();
 	imuMutex_.unlock();
+	lastFrameStamp_ = 0.0;
+	consecutiveSkippedFrames_ = 0;
+	predictionMutex_.lock();
+	predictionPose_.setNull();
+	predictionImus_.clear();
+	predictionMutex_.unlock();
 	this->flushCallbacks();
 }
 
@@ -1171,7 +1441,13 @@ bool OdometryROS::setLogError(std_srvs::Empty::Request&, std_srvs::Empty::Respon
 OdometryROS::OdomStatusTask::OdomStatusTask() :
 		diagnostic_updater::DiagnosticTask("Odom status"),
 		lost_(false),
-		dataReceived_(false)
+		dataReceived_(false),
+		framesReceived_(0),
+		framesDropped_(0),
+		framesSkipped_(0),
+		compressionDropped_(0),
+		load_(0.0),
+		latencies_(6)
 {}
 
 void OdometryROS::OdomStatusTask::setStatus(bool isLost)
@@ -1180,6 +1456,37 @@ void OdometryROS::OdomStatusTask::setStatus(bool isLost)
 	lost_ = isLost;
 }
 
+void OdometryROS::OdomStatusTask::setQueueStatus(unsigned long received, unsigned long dropped)
+{
+	framesReceived_ = received;
+	framesDropped_ = dropped;
+}
+
+void OdometryROS::OdomStatusTask::setBudgetStatus(unsigned long skipped, double load)
+{
+	framesSkipped_ = skipped;
+	load_ = load;
+}
+
+void OdometryROS::OdomStatusTask::setCompressionStatus(unsigned long dropped)
+{
+	compressionDropped_ = dropped;
+}
+
+void OdometryROS::OdomStatusTask::addLatency(double arrival, double preprocessing, double queue, double registration, double publishing)
+{
+	UScopeMutex lock(latencyMutex_);
+	double values[6] = {arrival, preprocessing, queue, registration, publishing, arrival+preprocessing+queue+registration+publishing};
+	for(int i=0; i<6; ++i)
+	{
+		latencies_[i].push_back(values[i]);
+		if(latencies_[i].size() > 300)
+		{
+			latencies_[i].pop_front();
+		}
+	}
+}
+
 void OdometryROS::OdomStatusTask::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
 {
 	if(!dataReceived_)
@@ -1194,6 +1501,28 @@ void OdometryROS::OdomStatusTask::run(diagnostic_updater::DiagnosticStatusWrappe
 	{
 		stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Tracking.");
 	}
+	stat.add("Frames received", framesReceived_);
+	stat.add("Frames dropped", framesDropped_);
+	stat.add("Frames skipped (cpu budget)", framesSkipped_);
+	stat.add("Compressed sensor data dropped", compressionDropped_);
+	stat.add("Processing load", load_);
+
+	// latency percentiles over the last frames
+	UScopeMutex lock(latencyMutex_);
+	const char * names[6] = {"Latency arrival", "Latency preprocessing", "Latency queue", "Latency registration", "Latency publishing", "Latency total"};
+	for(int i=0; i<6; ++i)
+	{
+		if(!latencies_[i].empty())
+		{
+			std::vector<double> values(latencies_[i].begin(), latencies_[i].end());
+			std::sort(values.begin(), values.end());
+			stat.addf(names[i], "p50=%.1fms p95=%.1fms p99=%.1fms max=%.1fms",
+					values[values.size()*50/100]*1000.0,
+					values[values.size()*95/100]*1000.0,
+					values[values.size()*99/100]*1000.0,
+					values.back()*1000.0);
+		}
+	}
 }
 
 }
@@ -0,0 +1,333 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Offline odometry replay: processes all frames of a database or of image
+// directories one after the other (no ROS graph, no rosbag timing) with the
+// same default parameters as the odometry nodes, then reports trajectory,
+// per-frame timings and throughput.
+
+#include <rtabmap/core/Odometry.h>
+#include <rtabmap/core/OdometryInfo.h>
+#include <rtabmap/core/Parameters.h>
+#include <rtabmap/core/DBReader.h>
+#include <rtabmap/core/Graph.h>
+#include <rtabmap/core/camera/CameraRGBDImages.h>
+#include <rtabmap/core/camera/CameraStereoImages.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UMath.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"odom_replay [options] --db database.db\n"
+			"odom_replay [options] --rgbd rgb_dir depth_dir calibration_dir camera_name\n"
+			"odom_replay [options] --stereo left_dir right_dir calibration_dir camera_name\n"
+			"Options:\n"
+			"    --type rgbd|stereo|icp|rgbdicp  Odometry node to replicate (default rgbd).\n"
+			"    --config path.ini               Odometry parameters.\n"
+			"    --depth_scale #                 Depth scale of --rgbd images (default 1).\n"
+			"    --max_frames #                  Stop after this number of frames.\n"
+			"    --stamps path.txt               Stamps of --rgbd/--stereo images (one per line).\n"
+			"    --stamps_from_filenames         File names of --rgbd/--stereo images are stamps.\n"
+			"    --rate #                        Frame rate used to set stamps of --rgbd/--stereo\n"
+			"                                    images without stamps (default 30 Hz).\n"
+			"    --poses path.txt                Save trajectory (TUM format).\n"
+			"    --timings path.csv              Save per-frame timings.\n"
+			"    --seed #                        Random seed (default 0).\n"
+			"    --Param value                   Any rtabmap parameter.\n\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	std::string type = "rgbd";
+	std::string configPath;
+	std::string databasePath;
+	std::vector<std::string> rgbdArgs;
+	std::vector<std::string> stereoArgs;
+	float depthScale = 1.0f;
+	int maxFrames = 0;
+	std::string stampsPath;
+	bool stampsFromFileNames = false;
+	float rate = 30.0f;
+	std::string posesPath;
+	std::string timingsPath;
+	unsigned int seed = 0;
+	for(int i=1; i<argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg.compare("--help") == 0 || arg.compare("-h") == 0)
+		{
+			showUsage();
+		}
+		else if(arg.compare("--type") == 0 && i+1<argc)
+		{
+			type = argv[++i];
+		}
+		else if(arg.compare("--config") == 0 && i+1<argc)
+		{
+			configPath = argv[++i];
+		}
+		else if(arg.compare("--db") == 0 && i+1<argc)
+		{
+			databasePath = argv[++i];
+		}
+		else if((arg.compare("--rgbd") == 0 || arg.compare("--stereo") == 0) && i+4<argc)
+		{
+			std::vector<std::string> & args = arg.compare("--rgbd") == 0?rgbdArgs:stereoArgs;
+			for(int j=0; j<4; ++j)
+			{
+				args.push_back(argv[++i]);
+			}
+		}
+		else if(arg.compare("--depth_scale") == 0 && i+1<argc)
+		{
+			depthScale = uStr2Float(argv[++i]);
+		}
+		else if(arg.compare("--max_frames") == 0 && i+1<argc)
+		{
+			maxFrames = atoi(argv[++i]);
+		}
+		else if(arg.compare("--stamps") == 0 && i+1<argc)
+		{
+			stampsPath = argv[++i];
+		}
+		else if(arg.compare("--stamps_from_filenames") == 0)
+		{
+			stampsFromFileNames = true;
+		}
+		else if(arg.compare("--rate") == 0 && i+1<argc)
+		{
+			rate = uStr2Float(argv[++i]);
+		}
+		else if(arg.compare("--poses") == 0 && i+1<argc)
+		{
+			posesPath = argv[++i];
+		}
+		else if(arg.compare("--timings") == 0 && i+1<argc)
+		{
+			timingsPath = argv[++i];
+		}
+		else if(arg.compare("--seed") == 0 && i+1<argc)
+		{
+			seed = atoi(argv[++i]);
+		}
+		else if(arg.compare("--udebug") == 0)
+		{
+			ULogger::setLevel(ULogger::kDebug);
+		}
+		else if(arg.compare("--uinfo") == 0)
+		{
+			ULogger::setLevel(ULogger::kInfo);
+		}
+	}
+	if(databasePath.empty() && rgbdArgs.empty() && stereoArgs.empty())
+	{
+		showUsage();
+	}
+	if(rate <= 0.0f)
+	{
+		printf("--rate should be > 0\n");
+		showUsage();
+	}
+
+	// Same default parameters as the odometry nodes
+	bool stereoParams = type.compare("stereo") == 0;
+	bool visParams = type.compare("icp") != 0;
+	bool icpParams = type.compare("icp") == 0 || type.compare("rgbdicp") == 0;
+	if(!stereoParams && !icpParams && type.compare("rgbd") != 0)
+	{
+		printf("Unknown odometry type \"%s\"\n", type.c_str());
+		showUsage();
+	}
+	ParametersMap parameters = Parameters::getDefaultOdometryParameters(stereoParams, visParams, icpParams);
+	uInsert(parameters, ParametersPair(Parameters::kRegStrategy(), icpParams?(visParams?"2":"1"):"0"));
+	if(!configPath.empty())
+	{
+		if(!UFile::exists(configPath))
+		{
+			printf("Config file \"%s\" doesn't exist!\n", configPath.c_str());
+			return -1;
+		}
+		ParametersMap allParameters;
+		Parameters::readINI(configPath, allParameters);
+		for(ParametersMap::iterator iter=parameters.begin(); iter!=parameters.end(); ++iter)
+		{
+			ParametersMap::iterator jter = allParameters.find(iter->first);
+			if(jter != allParameters.end())
+			{
+				iter->second = jter->second;
+			}
+		}
+	}
+	uInsert(parameters, Parameters::parseArguments(argc, argv, true));
+
+	std::unique_ptr<Camera> camera;
+	// Images without stamps would get the wall time when read, making the
+	// motion model and filters depend on the loading time of each run
+	bool syntheticStamps = false;
+	if(!databasePath.empty())
+	{
+		// odometry and features saved in the database are ignored
+		camera.reset(new DBReader(databasePath, 0.0f, true, false, false, 0, -1, 0, false, false, true));
+		if(!camera->init())
+		{
+			printf("Failed to open database \"%s\"\n", databasePath.c_str());
+			return -1;
+		}
+	}
+	else if(!rgbdArgs.empty())
+	{
+		CameraRGBDImages * images = new CameraRGBDImages(rgbdArgs[0], rgbdArgs[1], depthScale, 0.0f, CameraModel::opticalRotation());
+		images->setTimestamps(stampsFromFileNames, stampsPath, false);
+		syntheticStamps = !stampsFromFileNames && stampsPath.empty();
+		camera.reset(images);
+		if(!camera->init(rgbdArgs[2], rgbdArgs[3]))
+		{
+			printf("Failed to initialize RGB-D images \"%s\" and \"%s\"\n", rgbdArgs[0].c_str(), rgbdArgs[1].c_str());
+			return -1;
+		}
+	}
+	else
+	{
+		CameraStereoImages * images = new CameraStereoImages(stereoArgs[0], stereoArgs[1], false, 0.0f, CameraModel::opticalRotation());
+		images->setTimestamps(stampsFromFileNames, stampsPath, false);
+		syntheticStamps = !stampsFromFileNames && stampsPath.empty();
+		camera.reset(images);
+		if(!camera->init(stereoArgs[2], stereoArgs[3]))
+		{
+			printf("Failed to initialize stereo images \"%s\" and \"%s\"\n", stereoArgs[0].c_str(), stereoArgs[1].c_str());
+			return -1;
+		}
+	}
+
+	// deterministic RANSAC/feature sampling between runs
+	srand(seed);
+	cv::theRNG().state = seed;
+
+	std::unique_ptr<Odometry> odometry(Odometry::create(parameters));
+
+	std::map<int, Transform> poses;
+	std::map<int, double> stamps;
+	std::vector<double> times;
+	FILE * timingsFile = 0;
+	if(!timingsPath.empty())
+	{
+		timingsFile = fopen(timingsPath.c_str(), "w");
+		if(timingsFile == 0)
+		{
+			printf("Cannot open \"%s\"\n", timingsPath.c_str());
+			return -1;
+		}
+		fprintf(timingsFile, "frame,stamp,total,registration,features,inliers,lost\n");
+	}
+
+	int lost = 0;
+	UTimer totalTimer;
+	SensorData data = camera->takeImage();
+	while(data.isValid() && (maxFrames <= 0 || (int)times.size() < maxFrames))
+	{
+		if(syntheticStamps)
+		{
+			data.setStamp(double(times.size())/double(rate));
+		}
+		OdometryInfo info;
+		UTimer timer;
+		Transform pose = odometry->process(data, &info);
+		double time = timer.ticks();
+		int frame = (int)times.size()+1;
+		times.push_back(time);
+		if(pose.isNull())
+		{
+			++lost;
+		}
+		else
+		{
+			poses.insert(std::make_pair(frame, pose));
+			stamps.insert(std::make_pair(frame, data.stamp()));
+		}
+		if(timingsFile)
+		{
+			fprintf(timingsFile, "%d,%f,%f,%f,%d,%d,%d\n",
+					frame, data.stamp(), time, info.timeEstimation, info.features, info.reg.inliers, pose.isNull()?1:0);
+		}
+		data = camera->takeImage();
+	}
+	double totalTime = totalTimer.ticks();
+	if(timingsFile)
+	{
+		fclose(timingsFile);
+	}
+
+	if(times.empty())
+	{
+		printf("No frames processed!\n");
+		return -1;
+	}
+
+	if(!posesPath.empty())
+	{
+		// 1=RGBD-SLAM (TUM) format with stamps
+		if(!graph::exportPoses(posesPath, 1, poses, std::multimap<int, Link>(), stamps))
+		{
+			printf("Failed to save poses to \"%s\"\n", posesPath.c_str());
+		}
+	}
+
+	std::vector<double> sorted = times;
+	std::sort(sorted.begin(), sorted.end());
+	float x,y,z,roll,pitch,yaw;
+	odometry->getPose().getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+	printf("Frames:      %d (lost=%d)\n", (int)times.size(), lost);
+	printf("Odometry:    %f ms/frame (p50=%f p95=%f max=%f)\n",
+			uMean(times)*1000.0,
+			sorted[sorted.size()*50/100]*1000.0,
+			sorted[sorted.size()*95/100]*1000.0,
+			sorted.back()*1000.0);
+	printf("Throughput:  %f frames/s (%f s total, including data loading)\n", double(times.size())/totalTime, totalTime);
+	printf("Final pose:  xyz=%f,%f,%f rpy=%f,%f,%f\n", x,y,z,roll,pitch,yaw);
+
+	return 0;
+}
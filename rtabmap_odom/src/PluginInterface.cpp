@@ -6,6 +6,10 @@ namespace rtabmap_odom
 PluginInterface::PluginInterface()
   :  enabled_(false)
   , name_()
+  , calls_(0)
+  , lastTime_(0.0)
+  , totalTime_(0.0)
+  , maxTime_(0.0)
 {
 }
 
@@ -16,6 +20,31 @@ void PluginInterface::initialize(const std::string name, ros::NodeHandle & nh)
     onInitialize();
 }
 
+void PluginInterface::filter(sensor_msgs::PointCloud2 & msg)
+{
+    ros::WallTime start = ros::WallTime::now();
+    filterPointCloudInPlace(msg);
+    lastTime_ = (ros::WallTime::now() - start).toSec();
+    totalTime_ += lastTime_;
+    if(lastTime_ > maxTime_)
+    {
+        maxTime_ = lastTime_;
+    }
+    ++calls_;
+}
+
+void PluginInterface::filterPointCloudInPlace(sensor_msgs::PointCloud2 & msg)
+{
+    msg = filterPointCloud(msg);
+}
+
+sensor_msgs::PointCloud2 InPlacePluginInterface::filterPointCloud(const sensor_msgs::PointCloud2 msg)
+{
+    sensor_msgs::PointCloud2 output = msg;
+    filterPointCloudInPlace(output);
+    return output;
+}
+
 
 }  // end namespace rtabmap_odom
 
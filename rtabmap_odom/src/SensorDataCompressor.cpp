@@ -0,0 +1,226 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "rtabmap_odom/SensorDataCompressor.h"
+
+#include <rtabmap/core/Compression.h>
+#include <rtabmap/utilite/ULogger.h>
+
+using namespace rtabmap;
+
+namespace rtabmap_odom {
+
+void SensorDataCompressor::Worker::post(const cv::Mat & input, const std::string & format)
+{
+	input_ = input;
+	format_ = format;
+	start_.release();
+}
+
+cv::Mat SensorDataCompressor::Worker::wait()
+{
+	done_.acquire();
+	cv::Mat output = output_;
+	output_ = cv::Mat();
+	return output;
+}
+
+void SensorDataCompressor::Worker::mainLoop()
+{
+	start_.acquire();
+	if(!this->isRunning())
+	{
+		// thread killed
+		return;
+	}
+	output_ = scan_?compressData2(input_):compressImage2(input_, format_);
+	input_ = cv::Mat();
+	done_.release();
+}
+
+SensorDataCompressor::SensorDataCompressor(const std::string & imageFormat, bool parallel) :
+	imageFormat_(imageFormat),
+	parallel_(parallel),
+	imageWorker_(0),
+	depthWorker_(0),
+	scanWorker_(0),
+	pending_(false),
+	framesDropped_(0)
+{
+	if(parallel_)
+	{
+		imageWorker_ = new Worker(false);
+		depthWorker_ = new Worker(false);
+		scanWorker_ = new Worker(true);
+		imageWorker_->start();
+		depthWorker_->start();
+		scanWorker_->start();
+	}
+	this->start();
+}
+
+SensorDataCompressor::~SensorDataCompressor()
+{
+	this->join(true);
+	delete imageWorker_;
+	delete depthWorker_;
+	delete scanWorker_;
+}
+
+void SensorDataCompressor::compress(SensorData & data)
+{
+	const cv::Mat & depthOrRight = data.depthOrRightRaw();
+	std::string depthFormat = depthOrRight.type() == CV_32FC1 || depthOrRight.type() == CV_16UC1?std::string(".png"):imageFormat_;
+
+	cv::Mat compressedImage;
+	cv::Mat compressedDepth;
+	cv::Mat compressedScan;
+	if(parallel_)
+	{
+		bool image = !data.imageRaw().empty();
+		bool depth = !depthOrRight.empty();
+		bool scan = !data.laserScanRaw().isEmpty();
+		if(image)
+		{
+			imageWorker_->post(data.imageRaw(), imageFormat_);
+		}
+		if(depth)
+		{
+			depthWorker_->post(depthOrRight, depthFormat);
+		}
+		if(scan)
+		{
+			scanWorker_->post(data.laserScanRaw().data(), "");
+		}
+		if(image)
+		{
+			compressedImage = imageWorker_->wait();
+		}
+		if(depth)
+		{
+			compressedDepth = depthWorker_->wait();
+		}
+		if(scan)
+		{
+			compressedScan = scanWorker_->wait();
+		}
+	}
+	else
+	{
+		compressedImage = compressImage2(data.imageRaw(), imageFormat_);
+		compressedDepth = compressImage2(depthOrRight, depthFormat);
+		compressedScan = compressData2(data.laserScanRaw().data());
+	}
+
+	if(!compressedImage.empty() && !data.stereoCameraModels().empty())
+	{
+		data.setStereoImage(compressedImage, compressedDepth, data.stereoCameraModels(), false);
+	}
+	else if(!compressedImage.empty() && !data.cameraModels().empty())
+	{
+		data.setRGBDImage(compressedImage, compressedDepth, data.cameraModels(), false);
+	}
+	if(!compressedScan.empty())
+	{
+		data.setLaserScan(data.laserScanRaw().angleIncrement() == 0.0f?
+					LaserScan(compressedScan,
+						data.laserScanRaw().maxPoints(),
+						data.laserScanRaw().rangeMax(),
+						data.laserScanRaw().format(),
+						data.laserScanRaw().localTransform()):
+					LaserScan(compressedScan,
+						data.laserScanRaw().format(),
+						data.laserScanRaw().rangeMin(),
+						data.laserScanRaw().rangeMax(),
+						data.laserScanRaw().angleMin(),
+						data.laserScanRaw().angleMax(),
+						data.laserScanRaw().angleIncrement(),
+						data.laserScanRaw().localTransform()), false);
+	}
+}
+
+bool SensorDataCompressor::compressAsync(const SensorData & data, const std_msgs::Header & header, const Callback & callback)
+{
+	UScopeMutex lock(pendingMutex_);
+	bool dropped = pending_;
+	if(dropped)
+	{
+		++framesDropped_;
+	}
+	else
+	{
+		pendingReady_.release();
+	}
+	pending_ = true;
+	pendingData_ = data;
+	pendingHeader_ = header;
+	pendingCallback_ = callback;
+	return !dropped;
+}
+
+void SensorDataCompressor::mainLoopKill()
+{
+	// in case we were waiting, unblock thread
+	pendingReady_.release();
+}
+
+void SensorDataCompressor::mainLoop()
+{
+	pendingReady_.acquire();
+
+	if(!this->isRunning())
+	{
+		// thread killed
+		return;
+	}
+
+	SensorData data;
+	std_msgs::Header header;
+	Callback callback;
+	{
+		UScopeMutex lock(pendingMutex_);
+		if(!pending_)
+		{
+			return;
+		}
+		data = pendingData_;
+		header = pendingHeader_;
+		callback = pendingCallback_;
+		pendingData_ = SensorData();
+		pendingCallback_.clear();
+		pending_ = false;
+	}
+
+	compress(data);
+	if(callback)
+	{
+		callback(data, header);
+	}
+}
+
+}
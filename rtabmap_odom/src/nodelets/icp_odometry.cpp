@@ -38,6 +38,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sensor_msgs/PointCloud2.h>
 #include <pcl_conversions/pcl_conversions.h>
 #include <pcl_ros/transforms.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/search/kdtree.h>
 
 #include "rtabmap_conversions/MsgConversion.h"
 #include "rtabmap_odom/PluginInterface.h"
@@ -50,6 +52,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/ULogger.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UMutex.h>
 
 using namespace rtabmap;
 
@@ -70,8 +73,10 @@ public:
 		scanNormalK_(0),
 		scanNormalRadius_(0.0),
 		scanNormalGroundUp_(0.0),
+		scanNormalThreads_(0),
 		deskewing_(false),
 		deskewingSlerp_(false),
+		deskewingImu_(false),
 		plugin_loader_("rtabmap_odom", "rtabmap_odom::PluginInterface"),
 		scanReceived_(false),
 		cloudReceived_(false)
@@ -80,6 +85,14 @@ public:
 
 	virtual ~ICPOdometry()
 	{
+		for(size_t i=0; i<plugins_.size(); ++i)
+		{
+			if(plugins_[i]->calls())
+			{
+				NODELET_INFO("IcpOdometry: plugin %s filtered %ld clouds (mean=%fs, max=%fs)",
+						plugins_[i]->getName().c_str(), plugins_[i]->calls(), plugins_[i]->meanTime(), plugins_[i]->maxTime());
+			}
+		}
 		plugins_.clear();
 	}
 
@@ -101,8 +114,10 @@ private:
 		pnh.param("scan_normal_k",   scanNormalK_, scanNormalK_);
 		pnh.param("scan_normal_radius", scanNormalRadius_, scanNormalRadius_);
 		pnh.param("scan_normal_ground_up", scanNormalGroundUp_, scanNormalGroundUp_);
+		pnh.param("scan_normal_threads", scanNormalThreads_, scanNormalThreads_);
 		pnh.param("deskewing",  deskewing_, deskewing_);
 		pnh.param("deskewing_slerp",  deskewingSlerp_, deskewingSlerp_);
+		pnh.param("deskewing_imu",  deskewingImu_, deskewingImu_);
 
 		if (pnh.hasParam("plugins"))
 		{
@@ -150,8 +165,10 @@ private:
 		NODELET_INFO("IcpOdometry: scan_normal_k          = %d", scanNormalK_);
 		NODELET_INFO("IcpOdometry: scan_normal_radius     = %f m", scanNormalRadius_);
 		NODELET_INFO("IcpOdometry: scan_normal_ground_up  = %f", scanNormalGroundUp_);
+		NODELET_INFO("IcpOdometry: scan_normal_threads    = %d (0=all cores)", scanNormalThreads_);
 		NODELET_INFO("IcpOdometry: deskewing              = %s", deskewing_?"true":"false");
 		NODELET_INFO("IcpOdometry: deskewing_slerp        = %s", deskewingSlerp_?"true":"false");
+		NODELET_INFO("IcpOdometry: deskewing_imu          = %s", deskewingImu_?"true":"false");
 
 		scan_sub_ = nh.subscribe("scan", queueSize, &ICPOdometry::callbackScan, this);
 		cloud_sub_ = nh.subscribe("scan_cloud", queueSize, &ICPOdometry::callbackCloud, this);
@@ -323,8 +340,51 @@ private:
 		}
 	}
 
+	virtual bool isIMURequired() const
+	{
+		return deskewing_ && deskewingImu_;
+	}
+
+	// Fed by the IMU subscriber of OdometryROS
+	virtual void onIMU(double stamp, const rtabmap::IMU & imu)
+	{
+		if(!isIMURequired())
+		{
+			return;
+		}
+		UScopeMutex m(deskewingImuMutex_);
+		deskewingImus_.insert(std::make_pair(stamp, imu));
+		// keep only latest second, a scan should not be longer
+		while(deskewingImus_.begin()->first < stamp - 1.0)
+		{
+			deskewingImus_.erase(deskewingImus_.begin());
+		}
+	}
+
+	// Deskew in input frame with IMU, localTransform is base->input frame
+	bool deskewWithImu(const sensor_msgs::PointCloud2 & input, sensor_msgs::PointCloud2 & output, const Transform & localTransform)
+	{
+		std::map<double, rtabmap::IMU> imus;
+		{
+			UScopeMutex m(deskewingImuMutex_);
+			imus = deskewingImus_;
+		}
+		if(imus.empty())
+		{
+			ROS_ERROR("No IMU received on %s yet for deskewing!", imuTopic().c_str());
+			return false;
+		}
+		Transform velocity;
+		if(previousStamp() > 0)
+		{
+			velocity = velocityGuess();
+		}
+		return rtabmap_conversions::deskew(input, output, imus, localTransform, velocity);
+	}
+
 	void callbackScan(const sensor_msgs::LaserScanConstPtr& scanMsg)
 	{
+		ros::Time arrival = ros::Time::now();
 		if(cloudReceived_)
 		{
 			ROS_ERROR("%s is already receiving clouds on \"%s\", but also "
@@ -357,7 +417,7 @@ private:
 		sensor_msgs::PointCloud2 scanOut;
 		laser_geometry::LaserProjection projection;
 
-		if(deskewing_ && (!guessFrameId().empty() || (frameId().compare(scanMsg->header.frame_id) != 0)))
+		if(deskewing_ && !deskewingImu_ && (!guessFrameId().empty() || (frameId().compare(scanMsg->header.frame_id) != 0)))
 		{
 			// make sure the frame of the laser is updated during the whole scan time
 			rtabmap::Transform tmpT = rtabmap_conversions::getMovingTransform(
@@ -405,7 +465,18 @@ private:
 		{
 			projection.projectLaser(*scanMsg, scanOut, -1.0, laser_geometry::channel_option::Intensity | laser_geometry::channel_option::Timestamp);
 
-			if(deskewing_ && previousStamp() > 0 && !velocityGuess().isNull())
+			if(deskewing_ && deskewingImu_)
+			{
+				// deskew with IMU (we are in scan frame)
+				sensor_msgs::PointCloud2 scanOutDeskewed;
+				if(!deskewWithImu(scanOut, scanOutDeskewed, localScanTransform))
+				{
+					ROS_ERROR("Failed to deskew input cloud, aborting odometry update!");
+					return;
+				}
+				scanOut = scanOutDeskewed;
+			}
+			else if(deskewing_ && previousStamp() > 0 && !velocityGuess().isNull())
 			{
 				// deskew with constant velocity model
 				sensor_msgs::PointCloud2 scanOutDeskewed;
@@ -560,11 +631,12 @@ private:
 				0,
 				rtabmap_conversions::timestampFromROS(scanMsg->header.stamp));
 
-		this->processData(data, scanMsg->header);
+		this->processData(data, scanMsg->header, arrival);
 	}
 
 	void callbackCloud(const sensor_msgs::PointCloud2ConstPtr& pointCloudMsg)
 	{
+		ros::Time arrival = ros::Time::now();
 		UASSERT_MSG(pointCloudMsg->data.size() == pointCloudMsg->row_step*pointCloudMsg->height,
 				uFormat("data=%d row_step=%d height=%d", pointCloudMsg->data.size(), pointCloudMsg->row_step, pointCloudMsg->height).c_str());
 		
@@ -584,31 +656,28 @@ private:
 			return;
 		}
 
-		sensor_msgs::PointCloud2::Ptr cloudMsg(new sensor_msgs::PointCloud2);
-		if (!plugins_.empty())
+		// The input is copied only if at least one plugin is enabled, then
+		// the plugins are applied in place one after the other.
+		sensor_msgs::PointCloud2ConstPtr inputMsg = pointCloudMsg;
+		sensor_msgs::PointCloud2::Ptr filteredMsg;
+		for(size_t i=0; i<plugins_.size(); ++i)
 		{
-			if (plugins_[0]->isEnabled())
-			{
-				*cloudMsg = plugins_[0]->filterPointCloud(*pointCloudMsg);
-			}
-			else
-			{
-				*cloudMsg = *pointCloudMsg;
-			}
-
-			if (plugins_.size() > 1)
+			if(plugins_[i]->isEnabled())
 			{
-				for (int i = 1; i < plugins_.size(); i++) {
-					if (plugins_[i]->isEnabled()) {
-						*cloudMsg = plugins_[i]->filterPointCloud(*cloudMsg);
-					}
+				if(!filteredMsg.get())
+				{
+					filteredMsg.reset(new sensor_msgs::PointCloud2(*pointCloudMsg));
 				}
+				plugins_[i]->filter(*filteredMsg);
+				NODELET_DEBUG("IcpOdometry: plugin %s: %fs (mean=%fs, max=%fs)",
+						plugins_[i]->getName().c_str(), plugins_[i]->lastTime(), plugins_[i]->meanTime(), plugins_[i]->maxTime());
 			}
 		}
-		else
+		if(filteredMsg.get())
 		{
-			*cloudMsg = *pointCloudMsg;
+			inputMsg = filteredMsg;
 		}
+		sensor_msgs::PointCloud2ConstPtr cloudMsg = inputMsg;
 
 		Transform localScanTransform = rtabmap_conversions::getTransform(this->frameId(), cloudMsg->header.frame_id, cloudMsg->header.stamp, this->tfListener(), this->waitForTransformDuration());
 		if(localScanTransform.isNull())
@@ -619,26 +688,39 @@ private:
 
 		if(deskewing_)
 		{
-			if(!guessFrameId().empty())
+			if(deskewingImu_)
+			{
+				// deskew with IMU (we are in cloud frame)
+				sensor_msgs::PointCloud2::Ptr cloudDeskewed(new sensor_msgs::PointCloud2);
+				if(!deskewWithImu(*inputMsg, *cloudDeskewed, localScanTransform))
+				{
+					ROS_ERROR("Failed to deskew input cloud, aborting odometry update!");
+					return;
+				}
+				cloudMsg = cloudDeskewed;
+			}
+			else if(!guessFrameId().empty())
 			{
 				// deskew with TF
-				if(!rtabmap_conversions::deskew(*pointCloudMsg, *cloudMsg, guessFrameId(), tfListener(), waitForTransformDuration(), deskewingSlerp_))
+				sensor_msgs::PointCloud2::Ptr cloudDeskewed(new sensor_msgs::PointCloud2);
+				if(!rtabmap_conversions::deskew(*inputMsg, *cloudDeskewed, guessFrameId(), tfListener(), waitForTransformDuration(), deskewingSlerp_))
 				{
 					ROS_ERROR("Failed to deskew input cloud, aborting odometry update!");
 					return;
 				}
+				cloudMsg = cloudDeskewed;
 			}
 			else if(previousStamp() > 0 && !velocityGuess().isNull())
 			{
 				// deskew with constant velocity model
 				bool alreadyInBaseFrame = frameId().compare(pointCloudMsg->header.frame_id) == 0;
 				sensor_msgs::PointCloud2Ptr cloudInBaseFrame;
-				sensor_msgs::PointCloud2Ptr cloudPtr = cloudMsg;
+				sensor_msgs::PointCloud2ConstPtr cloudPtr = inputMsg;
 				if(!alreadyInBaseFrame)
 				{
 					// transform in base frame
 					cloudInBaseFrame.reset(new sensor_msgs::PointCloud2);
-					if(!pcl_ros::transformPointCloud(frameId(), *pointCloudMsg, *cloudInBaseFrame, this->tfListener()))
+					if(!pcl_ros::transformPointCloud(frameId(), *inputMsg, *cloudInBaseFrame, this->tfListener()))
 					{
 						ROS_ERROR("Cannot transform back projected scan from \"%s\" frame to \"%s\" frame at time %fs.",
 								pointCloudMsg->header.frame_id.c_str(), frameId().c_str(), pointCloudMsg->header.stamp.toSec());
@@ -657,12 +739,14 @@ private:
 				if(!alreadyInBaseFrame)
 				{
 					// put back in scan frame
-					if(!pcl_ros::transformPointCloud(pointCloudMsg->header.frame_id.c_str(), *cloudDeskewed, *cloudMsg, this->tfListener()))
+					sensor_msgs::PointCloud2::Ptr cloudInScanFrame(new sensor_msgs::PointCloud2);
+					if(!pcl_ros::transformPointCloud(pointCloudMsg->header.frame_id.c_str(), *cloudDeskewed, *cloudInScanFrame, this->tfListener()))
 					{
 						ROS_ERROR("Cannot transform back projected scan from \"%s\" frame to \"%s\" frame at time %fs.",
 								frameId().c_str(), pointCloudMsg->header.frame_id.c_str(), pointCloudMsg->header.stamp.toSec());
 						return;
 					}
+					cloudMsg = cloudInScanFrame;
 				}
 				else
 				{
@@ -728,6 +812,21 @@ private:
 		}
 		int maxLaserScans = scanCloudMaxPoints_;
 
+		// Common case (xyz[i] float fields, no normals in the input): filter
+		// directly from the message buffer in a single pass.
+		bool scanPreprocessed = false;
+		if(!hasNormals)
+		{
+			if(hasIntensity)
+			{
+				scanPreprocessed = preprocessCloud<pcl::PointXYZI>(*cloudMsg, scratchCloudI_, is3D, maxLaserScans, scan);
+			}
+			else
+			{
+				scanPreprocessed = preprocessCloud<pcl::PointXYZ>(*cloudMsg, scratchCloud_, is3D, maxLaserScans, scan);
+			}
+		}
+
 		if(hasNormals && hasIntensity)
 		{
 			pcl::PointCloud<pcl::PointXYZINormal>::Ptr pclScan(new pcl::PointCloud<pcl::PointXYZINormal>);
@@ -764,121 +863,259 @@ private:
 			}
 			scan = is3D?util3d::laserScanFromPointCloud(*pclScan):util3d::laserScan2dFromPointCloud(*pclScan);
 		}
-		else if(hasIntensity)
+		else if(!scanPreprocessed)
 		{
-			pcl::PointCloud<pcl::PointXYZI>::Ptr pclScan(new pcl::PointCloud<pcl::PointXYZI>);
-			pcl::fromROSMsg(*cloudMsg, *pclScan);
-			if(pclScan->size() && scanDownsamplingStep_ > 1)
+			if(hasIntensity)
 			{
-				pclScan = util3d::downsample(pclScan, scanDownsamplingStep_);
-				if(pclScan->height>1)
-				{
-					maxLaserScans = pclScan->height * pclScan->width;
-				}
-				else
-				{
-					maxLaserScans /= scanDownsamplingStep_;
-				}
+				pcl::PointCloud<pcl::PointXYZI>::Ptr pclScan(new pcl::PointCloud<pcl::PointXYZI>);
+				pcl::fromROSMsg(*cloudMsg, *pclScan);
+				scan = filterCloud<pcl::PointXYZI, pcl::PointXYZINormal>(pclScan, is3D, maxLaserScans);
 			}
-			if(!pclScan->is_dense)
+			else
 			{
-				pclScan = util3d::removeNaNFromPointCloud(pclScan);
+				pcl::PointCloud<pcl::PointXYZ>::Ptr pclScan(new pcl::PointCloud<pcl::PointXYZ>);
+				pcl::fromROSMsg(*cloudMsg, *pclScan);
+				scan = filterCloud<pcl::PointXYZ, pcl::PointNormal>(pclScan, is3D, maxLaserScans);
 			}
+		}
 
-			if(pclScan->size())
+		LaserScan laserScan(scan,
+				maxLaserScans,
+				0,
+				localScanTransform);
+		if(!scanPreprocessed && (scanRangeMin_ > 0 || scanRangeMax_ > 0))
+		{
+			laserScan = util3d::rangeFiltering(laserScan, scanRangeMin_, scanRangeMax_);
+		}
+		if(!laserScan.isEmpty() && laserScan.hasNormals() && !laserScan.is2d() && scanNormalGroundUp_)
+		{
+			laserScan = util3d::adjustNormalsToViewPoint(laserScan, Eigen::Vector3f(0,0,10), (float)scanNormalGroundUp_);
+		}
+
+		rtabmap::SensorData data(
+				laserScan,
+				cv::Mat(),
+				cv::Mat(),
+				rtabmap::CameraModel(),
+				0,
+				rtabmap_conversions::timestampFromROS(cloudMsg->header.stamp));
+
+		this->processData(data, cloudMsg->header, arrival);
+	}
+
+	static void setIntensity(pcl::PointXYZ &, float) {}
+	static void setIntensity(pcl::PointXYZI & pt, float intensity) {pt.intensity = intensity;}
+	static float getIntensity(const pcl::PointXYZ &) {return 0.0f;}
+	static float getIntensity(const pcl::PointXYZI & pt) {return pt.intensity;}
+
+	// Single pass over the message buffer doing NaN removal, range filtering
+	// and downsampling (every scan_downsampling_step points of each row) into
+	// a cloud reused between scans, followed by voxel filtering and normals.
+	// Returns false if the cloud layout is not supported (big endian, non float
+	// coordinates, or downsampling of a depth-image-like organized cloud).
+	template<typename PointT>
+	bool preprocessCloud(
+			const sensor_msgs::PointCloud2 & msg,
+			typename pcl::PointCloud<PointT>::Ptr & cloud,
+			bool is3D,
+			int & maxLaserScans,
+			LaserScan & scan)
+	{
+		int offsetX=-1, offsetY=-1, offsetZ=-1, offsetI=-1;
+		for(size_t i=0; i<msg.fields.size(); ++i)
+		{
+			const sensor_msgs::PointField & field = msg.fields[i];
+			if(field.datatype != sensor_msgs::PointField::FLOAT32)
 			{
-				if(scanVoxelSize_ > 0.0f)
-				{
-					float pointsBeforeFiltering = (float)pclScan->size();
-					pclScan = util3d::voxelize(pclScan, scanVoxelSize_);
-					float ratio = float(pclScan->size()) / pointsBeforeFiltering;
-					maxLaserScans = int(float(maxLaserScans) * ratio);
-				}
-				if(scanNormalK_ > 0 || scanNormalRadius_>0.0f)
-				{
-					//compute normals
-					pcl::PointCloud<pcl::Normal>::Ptr normals = is3D?
-							util3d::computeNormals(pclScan, scanNormalK_, scanNormalRadius_):
-							util3d::computeNormals2D(pclScan, scanNormalK_, scanNormalRadius_);
-					pcl::PointCloud<pcl::PointXYZINormal>::Ptr pclScanNormal(new pcl::PointCloud<pcl::PointXYZINormal>);
-					pcl::concatenateFields(*pclScan, *normals, *pclScanNormal);
-					scan = is3D?util3d::laserScanFromPointCloud(*pclScanNormal):util3d::laserScan2dFromPointCloud(*pclScanNormal);
-				}
-				else
-				{
-					scan = is3D?util3d::laserScanFromPointCloud(*pclScan):util3d::laserScan2dFromPointCloud(*pclScan);
-				}
+				continue;
 			}
+			if(field.name.compare("x") == 0) offsetX = field.offset;
+			else if(field.name.compare("y") == 0) offsetY = field.offset;
+			else if(field.name.compare("z") == 0) offsetZ = field.offset;
+			else if(field.name.compare("intensity") == 0) offsetI = field.offset;
 		}
-		else
+		if(msg.is_bigendian || offsetX < 0 || offsetY < 0 || (is3D && offsetZ < 0) ||
+		   (scanDownsamplingStep_ > 1 && msg.height > 1 && msg.height >= msg.width/4))
 		{
-			pcl::PointCloud<pcl::PointXYZ>::Ptr pclScan(new pcl::PointCloud<pcl::PointXYZ>);
-			pcl::fromROSMsg(*cloudMsg, *pclScan);
-			if(pclScan->size() && scanDownsamplingStep_ > 1)
+			return false;
+		}
+
+		const int step = scanDownsamplingStep_>1?scanDownsamplingStep_:1;
+		const float rangeMinSqr = scanRangeMin_*scanRangeMin_;
+		const float rangeMaxSqr = scanRangeMax_*scanRangeMax_;
+		if(!cloud.get())
+		{
+			cloud.reset(new pcl::PointCloud<PointT>);
+		}
+		cloud->clear(); // keeps capacity of the previous scans
+		cloud->reserve(msg.width*msg.height/step);
+		for(unsigned int row=0; row<msg.height; ++row)
+		{
+			const unsigned char * rowPtr = msg.data.data() + row*msg.row_step;
+			for(unsigned int col=0; col<msg.width; col+=step)
 			{
-				pclScan = util3d::downsample(pclScan, scanDownsamplingStep_);
-				if(pclScan->height>1)
+				const unsigned char * ptr = rowPtr + col*msg.point_step;
+				PointT pt;
+				pt.x = *(const float*)(ptr + offsetX);
+				pt.y = *(const float*)(ptr + offsetY);
+				pt.z = offsetZ>=0?*(const float*)(ptr + offsetZ):0.0f;
+				if(!std::isfinite(pt.x) || !std::isfinite(pt.y) || !std::isfinite(pt.z))
 				{
-					maxLaserScans = pclScan->height * pclScan->width;
+					continue;
 				}
-				else
+				if(rangeMinSqr > 0.0f || rangeMaxSqr > 0.0f)
 				{
-					maxLaserScans /= scanDownsamplingStep_;
+					float r = pt.x*pt.x + pt.y*pt.y + (is3D?pt.z*pt.z:0.0f);
+					if((rangeMinSqr > 0.0f && r < rangeMinSqr) || (rangeMaxSqr > 0.0f && r > rangeMaxSqr))
+					{
+						continue;
+					}
 				}
+				setIntensity(pt, offsetI>=0?*(const float*)(ptr + offsetI):0.0f);
+				cloud->push_back(pt);
 			}
-			if(!pclScan->is_dense)
+		}
+		cloud->is_dense = true;
+		if(step > 1)
+		{
+			if(msg.height > 1)
+			{
+				maxLaserScans = msg.height * (msg.width/step);
+			}
+			else
 			{
-				pclScan = util3d::removeNaNFromPointCloud(pclScan);
+				maxLaserScans /= step;
 			}
+		}
 
-			if(pclScan->size())
+		typename pcl::PointCloud<PointT>::Ptr filtered = cloud;
+		if(filtered->size() && scanVoxelSize_ > 0.0f)
+		{
+			float pointsBeforeFiltering = (float)filtered->size();
+			filtered = util3d::voxelize(filtered, scanVoxelSize_);
+			float ratio = float(filtered->size()) / pointsBeforeFiltering;
+			maxLaserScans = int(float(maxLaserScans) * ratio);
+		}
+
+		pcl::PointCloud<pcl::Normal>::Ptr normals;
+		if(filtered->size() && (scanNormalK_ > 0 || scanNormalRadius_>0.0f))
+		{
+			if(is3D)
 			{
-				if(scanVoxelSize_ > 0.0f)
-				{
-					float pointsBeforeFiltering = (float)pclScan->size();
-					pclScan = util3d::voxelize(pclScan, scanVoxelSize_);
-					float ratio = float(pclScan->size()) / pointsBeforeFiltering;
-					maxLaserScans = int(float(maxLaserScans) * ratio);
-				}
-				if(scanNormalK_ > 0 || scanNormalRadius_>0.0f)
+				typename pcl::search::KdTree<PointT>::Ptr tree(new pcl::search::KdTree<PointT>);
+				tree->setInputCloud(filtered);
+				pcl::NormalEstimationOMP<PointT, pcl::Normal> ne(scanNormalThreads_);
+				ne.setInputCloud(filtered);
+				ne.setSearchMethod(tree);
+				ne.setKSearch(scanNormalK_);
+				ne.setRadiusSearch(scanNormalRadius_);
+				ne.setViewPoint(0, 0, 0);
+				if(!scratchNormals_.get())
 				{
-					//compute normals
-					pcl::PointCloud<pcl::Normal>::Ptr normals = is3D?
-							util3d::computeNormals(pclScan, scanNormalK_, scanNormalRadius_):
-							util3d::computeNormals2D(pclScan, scanNormalK_, scanNormalRadius_);
-					pcl::PointCloud<pcl::PointNormal>::Ptr pclScanNormal(new pcl::PointCloud<pcl::PointNormal>);
-					pcl::concatenateFields(*pclScan, *normals, *pclScanNormal);
-					scan = is3D?util3d::laserScanFromPointCloud(*pclScanNormal):util3d::laserScan2dFromPointCloud(*pclScanNormal);
+					scratchNormals_.reset(new pcl::PointCloud<pcl::Normal>);
 				}
-				else
+				ne.compute(*scratchNormals_);
+				normals = scratchNormals_;
+			}
+			else
+			{
+				normals = util3d::computeNormals2D(filtered, scanNormalK_, scanNormalRadius_);
+			}
+		}
+
+		// write the scan directly, skipping points without valid normal
+		bool hasI = pcl::traits::has_field<PointT, pcl::fields::intensity>::value;
+		LaserScan::Format format;
+		if(is3D)
+		{
+			format = hasI?(normals.get()?LaserScan::kXYZINormal:LaserScan::kXYZI):(normals.get()?LaserScan::kXYZNormal:LaserScan::kXYZ);
+		}
+		else
+		{
+			format = hasI?(normals.get()?LaserScan::kXYINormal:LaserScan::kXYI):(normals.get()?LaserScan::kXYNormal:LaserScan::kXY);
+		}
+		int channels = LaserScan::channels(format);
+		cv::Mat data(1, filtered->size(), CV_32FC(channels));
+		int oi = 0;
+		for(size_t i=0; i<filtered->size(); ++i)
+		{
+			const PointT & pt = filtered->at(i);
+			float * out = data.ptr<float>(0, oi);
+			int c = 0;
+			out[c++] = pt.x;
+			out[c++] = pt.y;
+			if(is3D)
+			{
+				out[c++] = pt.z;
+			}
+			if(hasI)
+			{
+				out[c++] = getIntensity(pt);
+			}
+			if(normals.get())
+			{
+				const pcl::Normal & n = normals->at(i);
+				if(!std::isfinite(n.normal_x) || !std::isfinite(n.normal_y) || !std::isfinite(n.normal_z))
 				{
-					scan = is3D?util3d::laserScanFromPointCloud(*pclScan):util3d::laserScan2dFromPointCloud(*pclScan);
+					continue;
 				}
+				out[c++] = n.normal_x;
+				out[c++] = n.normal_y;
+				out[c++] = n.normal_z;
 			}
+			++oi;
 		}
+		scan = LaserScan(oi?cv::Mat(data, cv::Range::all(), cv::Range(0, oi)):cv::Mat(), 0, 0, format);
+		return true;
+	}
 
-		LaserScan laserScan(scan,
-				maxLaserScans,
-				0,
-				localScanTransform);
-		if(scanRangeMin_ > 0 || scanRangeMax_ > 0)
+	// Filtering of clouds not supported by preprocessCloud()
+	template<typename PointT, typename PointNormalT>
+	LaserScan filterCloud(typename pcl::PointCloud<PointT>::Ptr pclScan, bool is3D, int & maxLaserScans)
+	{
+		LaserScan scan;
+		if(pclScan->size() && scanDownsamplingStep_ > 1)
 		{
-			laserScan = util3d::rangeFiltering(laserScan, scanRangeMin_, scanRangeMax_);
+			pclScan = util3d::downsample(pclScan, scanDownsamplingStep_);
+			if(pclScan->height>1)
+			{
+				maxLaserScans = pclScan->height * pclScan->width;
+			}
+			else
+			{
+				maxLaserScans /= scanDownsamplingStep_;
+			}
 		}
-		if(!laserScan.isEmpty() && laserScan.hasNormals() && !laserScan.is2d() && scanNormalGroundUp_)
+		if(!pclScan->is_dense)
 		{
-			laserScan = util3d::adjustNormalsToViewPoint(laserScan, Eigen::Vector3f(0,0,10), (float)scanNormalGroundUp_);
+			pclScan = util3d::removeNaNFromPointCloud(pclScan);
 		}
 
-		rtabmap::SensorData data(
-				laserScan,
-				cv::Mat(),
-				cv::Mat(),
-				rtabmap::CameraModel(),
-				0,
-				rtabmap_conversions::timestampFromROS(cloudMsg->header.stamp));
-
-		this->processData(data, cloudMsg->header);
+		if(pclScan->size())
+		{
+			if(scanVoxelSize_ > 0.0f)
+			{
+				float pointsBeforeFiltering = (float)pclScan->size();
+				pclScan = util3d::voxelize(pclScan, scanVoxelSize_);
+				float ratio = float(pclScan->size()) / pointsBeforeFiltering;
+				maxLaserScans = int(float(maxLaserScans) * ratio);
+			}
+			if(scanNormalK_ > 0 || scanNormalRadius_>0.0f)
+			{
+				//compute normals
+				pcl::PointCloud<pcl::Normal>::Ptr normals = is3D?
+						util3d::computeNormals(pclScan, scanNormalK_, scanNormalRadius_):
+						util3d::computeNormals2D(pclScan, scanNormalK_, scanNormalRadius_);
+				typename pcl::PointCloud<PointNormalT>::Ptr pclScanNormal(new pcl::PointCloud<PointNormalT>);
+				pcl::concatenateFields(*pclScan, *normals, *pclScanNormal);
+				scan = is3D?util3d::laserScanFromPointCloud(*pclScanNormal):util3d::laserScan2dFromPointCloud(*pclScanNormal);
+			}
+			else
+			{
+				scan = is3D?util3d::laserScanFromPointCloud(*pclScan):util3d::laserScan2dFromPointCloud(*pclScan);
+			}
+		}
+		return scan;
 	}
 
 protected:
@@ -911,8 +1148,16 @@ private:
 	int scanNormalK_;
 	double scanNormalRadius_;
 	double scanNormalGroundUp_;
+	int scanNormalThreads_;
+	// scratch buffers reused between scans
+	pcl::PointCloud<pcl::PointXYZ>::Ptr scratchCloud_;
+	pcl::PointCloud<pcl::PointXYZI>::Ptr scratchCloudI_;
+	pcl::PointCloud<pcl::Normal>::Ptr scratchNormals_;
 	bool deskewing_;
 	bool deskewingSlerp_;
+	bool deskewingImu_;
+	UMutex deskewingImuMutex_;
+	std::map<double, rtabmap::IMU> deskewingImus_;
 	std::vector<boost::shared_ptr<rtabmap_odom::PluginInterface> > plugins_;
 	pluginlib::ClassLoader<rtabmap_odom::PluginInterface> plugin_loader_;
 	bool scanReceived_ = false;
@@ -44,6 +44,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cv_bridge/cv_bridge.h>
 
 #include "rtabmap_conversions/MsgConversion.h"
+#include "rtabmap_odom/FeatureExtractor.h"
 #include <rtabmap_msgs/RGBDImages.h>
 
 #include <rtabmap/core/util3d.h>
@@ -76,7 +77,8 @@ public:
 		exactSync6_(0),
 		topicQueueSize_(1),
 		syncQueueSize_(5),
-		keepColor_(false)
+		keepColor_(false),
+		parallelFeatures_(false)
 	{
 	}
 
@@ -135,6 +137,17 @@ private:
 			rgbdCameras = 0;
 		}
 		pnh.param("keep_color", keepColor_, keepColor_);
+		pnh.param("parallel_features", parallelFeatures_, parallelFeatures_);
+		if(parallelFeatures_ && !FeatureExtractor::isSupported(this->parameters()))
+		{
+			NODELET_WARN("\"parallel_features\" can only be used with Odom/Strategy=0 or 1, "
+					"Vis/CorType=0 and Odom/ImageDecimation=1. It is disabled.");
+			parallelFeatures_ = false;
+		}
+		if(parallelFeatures_)
+		{
+			featureExtractor_.reset(new FeatureExtractor(this->parameters()));
+		}
 
 		NODELET_INFO("RGBDOdometry: approx_sync    = %s", approxSync?"true":"false");
 		if(approxSync)
@@ -144,6 +157,7 @@ private:
 		NODELET_INFO("RGBDOdometry: subscribe_rgbd = %s", subscribeRGBD?"true":"false");
 		NODELET_INFO("RGBDOdometry: rgbd_cameras   = %d", rgbdCameras);
 		NODELET_INFO("RGBDOdometry: keep_color     = %s", keepColor_?"true":"false");
+		NODELET_INFO("RGBDOdometry: parallel_features = %s", parallelFeatures_?"true":"false");
 
 		std::string subscribedTopic;
 		std::string subscribedTopicsMsg;
@@ -428,6 +442,7 @@ private:
 				const std::vector<cv_bridge::CvImageConstPtr> & depthImages,
 				const std::vector<sensor_msgs::CameraInfo>& cameraInfos)
 	{
+		ros::Time arrival = ros::Time::now();
 		ROS_ASSERT(rgbImages.size() > 0 && rgbImages.size() == depthImages.size() && rgbImages.size() == cameraInfos.size());
 		ros::Time higherStamp;
 		int imageWidth = rgbImages[0]->image.cols;
@@ -572,10 +587,16 @@ private:
 				0,
 				rtabmap_conversions::timestampFromROS(higherStamp));
 
+		// detect features of each camera in parallel
+		if(featureExtractor_.get() && !featureExtractor_->extract(data))
+		{
+			NODELET_WARN_THROTTLE(10, "Features could not be extracted per camera, odometry will extract them.");
+		}
+
 		std_msgs::Header header;
 		header.stamp = higherStamp;
 		header.frame_id = rgbImages.size()==1?rgbImages[0]->header.frame_id:"";
-		this->processData(data, header);
+		this->processData(data, header, arrival);
 	}
 
 	void callback(
@@ -934,6 +955,8 @@ private:
 	int topicQueueSize_;
 	int syncQueueSize_;
 	bool keepColor_;
+	bool parallelFeatures_;
+	std::unique_ptr<FeatureExtractor> featureExtractor_;
 };
 
 PLUGINLIB_EXPORT_CLASS(rtabmap_odom::RGBDOdometry, nodelet::Nodelet);
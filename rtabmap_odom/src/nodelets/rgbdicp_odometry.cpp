@@ -257,6 +257,7 @@ private:
 			const sensor_msgs::LaserScanConstPtr& scanMsg,
 			const sensor_msgs::PointCloud2ConstPtr& cloudMsg)
 	{
+		ros::Time arrival = ros::Time::now();
 		if(!this->isPaused())
 		{
 			if(!(image->encoding.compare(sensor_msgs::image_encodings::TYPE_8UC1) ==0 ||
@@ -462,7 +463,7 @@ private:
 				std_msgs::Header header;
 				header.stamp = stamp;
 				header.frame_id = image->header.frame_id;
-				this->processData(data, header);
+				this->processData(data, header, arrival);
 			}
 		}
 	}
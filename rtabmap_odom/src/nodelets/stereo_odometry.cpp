@@ -44,6 +44,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cv_bridge/cv_bridge.h>
 
 #include "rtabmap_conversions/MsgConversion.h"
+#include "rtabmap_odom/FeatureExtractor.h"
 #include <rtabmap_msgs/RGBDImages.h>
 
 #include <rtabmap/utilite/ULogger.h>
@@ -76,7 +77,8 @@ public:
 		exactSync6_(0),
 		topicQueueSize_(1),
 		syncQueueSize_(5),
-		keepColor_(false)
+		keepColor_(false),
+		parallelFeatures_(false)
 	{
 	}
 
@@ -126,6 +128,17 @@ private:
 		pnh.param("subscribe_rgbd", subscribeRGBD, subscribeRGBD);
 		pnh.param("rgbd_cameras", rgbdCameras, rgbdCameras);
 		pnh.param("keep_color", keepColor_, keepColor_);
+		pnh.param("parallel_features", parallelFeatures_, parallelFeatures_);
+		if(parallelFeatures_ && !FeatureExtractor::isSupported(this->parameters()))
+		{
+			NODELET_WARN("\"parallel_features\" can only be used with Odom/Strategy=0 or 1, "
+					"Vis/CorType=0 and Odom/ImageDecimation=1. It is disabled.");
+			parallelFeatures_ = false;
+		}
+		if(parallelFeatures_)
+		{
+			featureExtractor_.reset(new FeatureExtractor(this->parameters()));
+		}
 
 		NODELET_INFO("StereoOdometry: approx_sync = %s", approxSync?"true":"false");
 		if(approxSync)
@@ -134,6 +147,7 @@ private:
 		NODELET_INFO("StereoOdometry: sync_queue_size = %d", syncQueueSize_);
 		NODELET_INFO("StereoOdometry: subscribe_rgbd = %s", subscribeRGBD?"true":"false");
 		NODELET_INFO("StereoOdometry: keep_color = %s", keepColor_?"true":"false");
+		NODELET_INFO("StereoOdometry: parallel_features = %s", parallelFeatures_?"true":"false");
 
 		std::string subscribedTopic;
 		std::string subscribedTopicsMsg;
@@ -414,6 +428,7 @@ private:
 			const std::vector<sensor_msgs::CameraInfo>& leftCameraInfos,
 			const std::vector<sensor_msgs::CameraInfo>& rightCameraInfos)
 	{
+		ros::Time arrival = ros::Time::now();
 		UASSERT(leftImages.size() > 0 &&
 				leftImages.size() == rightImages.size() &&
 				leftImages.size() == leftCameraInfos.size() &&
@@ -678,10 +693,16 @@ private:
 				0,
 				rtabmap_conversions::timestampFromROS(higherStamp));
 
+		// detect features of each camera in parallel
+		if(featureExtractor_.get() && !featureExtractor_->extract(data))
+		{
+			NODELET_WARN_THROTTLE(10, "Features could not be extracted per camera, odometry will extract them.");
+		}
+
 		std_msgs::Header header;
 		header.stamp = higherStamp;
 		header.frame_id = leftImages.size()==1?leftImages[0]->header.frame_id:"";
-		this->processData(data, header);
+		this->processData(data, header, arrival);
 	}
 
 	void callback(
@@ -1075,6 +1096,8 @@ private:
 	int topicQueueSize_;
 	int syncQueueSize_;
 	bool keepColor_;
+	bool parallelFeatures_;
+	std::unique_ptr<FeatureExtractor> featureExtractor_;
 };
 
 PLUGINLIB_EXPORT_CLASS(rtabmap_odom::StereoOdometry, nodelet::Nodelet);
@@ -284,12 +284,13 @@ void MapCloudDisplay::processMapData(const rtabmap_msgs::MapData& map)
 	// Add new clouds...
 	bool fromDepth = !cloud_from_scan_->getBool();
 	std::set<int> nodeDataReceived;
-	for(unsigned int i=0; i<map.nodes.size() && i<map.nodes.size(); ++i)
+	std::vector<rtabmap::Signature> nodes = rtabmap_conversions::nodesFromROS(map.nodes);
+	for(unsigned int i=0; i<map.nodes.size() && i<nodes.size(); ++i)
 	{
 		int id = map.nodes[i].id;
 
 		// Always refresh the cloud if there are data
-		rtabmap::Signature s = rtabmap_conversions::nodeFromROS(map.nodes[i]);
+		rtabmap::Signature & s = nodes[i];
 		if((fromDepth &&
 			!s.sensorData().imageCompressed().empty() &&
 		    !s.sensorData().depthOrRightCompressed().empty() &&
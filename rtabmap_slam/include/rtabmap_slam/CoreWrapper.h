@@ -71,6 +71,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "rtabmap_util/MapsManager.h"
 #include "rtabmap_util/ULogToRosout.h"
+#include "rtabmap_util/ThreadScheduling.h"
 
 #ifdef WITH_OCTOMAP_MSGS
 #include <octomap_msgs/GetOctomap.h>
@@ -204,6 +205,9 @@ private:
 	bool loadDatabaseCallback(rtabmap_msgs::LoadDatabase::Request&, rtabmap_msgs::LoadDatabase::Response&);
 	bool triggerNewMapCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
 	bool backupDatabaseCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
+	bool saveMapCacheCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
+	std::string databaseIdentity() const;
+	std::string mapCacheDatabaseId() const;
 	bool detectMoreLoopClosuresCallback(rtabmap_msgs::DetectMoreLoopClosures::Request&, rtabmap_msgs::DetectMoreLoopClosures::Response&);
 	bool globalBundleAdjustmentCallback(rtabmap_msgs::GlobalBundleAdjustment::Request&, rtabmap_msgs::GlobalBundleAdjustment::Response&);
 	bool cleanupLocalGridsCallback(rtabmap_msgs::CleanupLocalGrids::Request&, rtabmap_msgs::CleanupLocalGrids::Response&);
@@ -280,6 +284,9 @@ private:
 	double waitForTransformDuration_;
 	bool useActionForGoal_;
 	bool useSavedMap_;
+	std::string mapCachePath_;
+	std::string mapCacheDatabaseIdOnInit_;
+	bool packedFeatures_;
 	bool genScan_;
 	double genScanMaxDepth_;
 	double genScanMinDepth_;
@@ -330,6 +337,7 @@ private:
 	ros::ServiceServer loadDatabaseSrv_;
 	ros::ServiceServer triggerNewMapSrv_;
 	ros::ServiceServer backupDatabase_;
+	ros::ServiceServer saveMapCacheSrv_;
 	ros::ServiceServer detectMoreLoopClosuresSrv_;
 	ros::ServiceServer globalBundleAdjustmentSrv_;
 	ros::ServiceServer cleanupLocalGridsSrv_;
@@ -403,6 +411,9 @@ private:
 	ros::Time previousStamp_;
 
 	rtabmap_util::ULogToRosout ulogToRosout_;
+	rtabmap_util::ThreadScheduling tfThreadScheduling_;
+	rtabmap_util::CallbackThreadsScheduling callbackThreadsScheduling_;
+	rtabmap_util::ThreadSchedulingTask threadSchedulingDiagnostic_;
 
 	class LocalizationStatusTask : public diagnostic_updater::DiagnosticTask
 	{
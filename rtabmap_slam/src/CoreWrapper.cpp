@@ -106,6 +106,7 @@ CoreWrapper::CoreWrapper() :
 		waitForTransformDuration_(0.2), // 200 ms
 		useActionForGoal_(false),
 		useSavedMap_(true),
+		packedFeatures_(false),
 		genScan_(false),
 		genScanMaxDepth_(4.0),
 		genScanMinDepth_(0.0),
@@ -200,6 +201,8 @@ void CoreWrapper::onInit()
 	pnh.param("initial_pose",          initialPoseStr, initialPoseStr);
 	pnh.param("use_action_for_goal", useActionForGoal_, useActionForGoal_);
 	pnh.param("use_saved_map", useSavedMap_, useSavedMap_);
+	pnh.param("map_cache_path", mapCachePath_, mapCachePath_);
+	pnh.param("packed_features", packedFeatures_, packedFeatures_);
 	pnh.param("gen_scan",            genScan_, genScan_);
 	pnh.param("gen_scan_max_depth",  genScanMaxDepth_, genScanMaxDepth_);
 	pnh.param("gen_scan_min_depth",  genScanMinDepth_, genScanMinDepth_);
@@ -248,6 +251,7 @@ void CoreWrapper::onInit()
 	NODELET_INFO("rtabmap: tf_tolerance  = %f", tfTolerance);
 	NODELET_INFO("rtabmap: odom_sensor_sync   = %s", odomSensorSync_?"true":"false");
 	NODELET_INFO("rtabmap: pub_loc_pose_only_when_localizing = %s", pubLocPoseOnlyWhenLocalizing_?"true":"false");
+	NODELET_INFO("rtabmap: packed_features = %s", packedFeatures_?"true":"false");
 	bool subscribeStereo = false;
 	pnh.param("subscribe_stereo",      subscribeStereo, subscribeStereo);
 	if(subscribeStereo)
@@ -652,10 +656,24 @@ void CoreWrapper::onInit()
 
 	// Init RTAB-Map
 	rtabmap_.init(parameters_, databasePath_);
+	mapCacheDatabaseIdOnInit_ = databaseIdentity();
 
 	if(rtabmap_.getMemory())
 	{
-		if(useSavedMap_)
+		if(!mapCachePath_.empty() && UFile::exists(mapCachePath_))
+		{
+			// Avoid regenerating all local grids and assembled maps from the database
+			try
+			{
+				mapsManager_.loadCache(mapCachePath_, rtabmap_.getLocalOptimizedPoses(), mapCacheDatabaseIdOnInit_);
+			}
+			catch(const std::exception & e)
+			{
+				NODELET_ERROR("rtabmap: Failed to load map cache \"%s\" (%s), ignoring it.", mapCachePath_.c_str(), e.what());
+				mapsManager_.clear();
+			}
+		}
+		if(useSavedMap_ && mapsManager_.getOccupancyGrid()->addedNodes().empty())
 		{
 			float xMin, yMin, gridCellSize;
 			cv::Mat map = rtabmap_.getMemory()->load2DMap(xMin, yMin, gridCellSize);
@@ -696,6 +714,7 @@ void CoreWrapper::onInit()
 	loadDatabaseSrv_ = nh.advertiseService("load_database", &CoreWrapper::loadDatabaseCallback, this);
 	triggerNewMapSrv_ = nh.advertiseService("trigger_new_map", &CoreWrapper::triggerNewMapCallback, this);
 	backupDatabase_ = nh.advertiseService("backup", &CoreWrapper::backupDatabaseCallback, this);
+	saveMapCacheSrv_ = nh.advertiseService("save_map_cache", &CoreWrapper::saveMapCacheCallback, this);
 	detectMoreLoopClosuresSrv_ = nh.advertiseService("detect_more_loop_closures", &CoreWrapper::detectMoreLoopClosuresCallback, this);
 	globalBundleAdjustmentSrv_ = nh.advertiseService("global_bundle_adjustment", &CoreWrapper::globalBundleAdjustmentCallback, this);
 	cleanupLocalGridsSrv_ = nh.advertiseService("cleanup_local_grids", &CoreWrapper::cleanupLocalGridsCallback, this);
@@ -734,6 +753,8 @@ void CoreWrapper::onInit()
 	Parameters::parse(parameters_, Parameters::kOptimizerIterations(), optimizeIterations);
 	if(publishTf && optimizeIterations != 0)
 	{
+		tfThreadScheduling_ = rtabmap_util::ThreadScheduling("rtabmap_tf");
+		tfThreadScheduling_.load(pnh, "tf_thread");
 		tfThreadRunning_ = true;
 		transformThread_ = new boost::thread(boost::bind(&CoreWrapper::publishLoop, this, tfDelay, tfTolerance));
 	}
@@ -743,7 +764,11 @@ void CoreWrapper::onInit()
 				Parameters::kOptimizerIterations().c_str(), mapFrameId_.c_str());
 	}
 
+	// applied from the data callbacks, subscribed below
+	callbackThreadsScheduling_.load(pnh, "callback_threads", &threadSchedulingDiagnostic_);
+
 	std::vector<diagnostic_updater::DiagnosticTask*> tasks;
+	tasks.push_back(&threadSchedulingDiagnostic_);
 	double localizationThreshold = 0.0f;
 	pnh.param("loc_thr", localizationThreshold, localizationThreshold);
 	if(rtabmap_.getMemory() && !rtabmap_.getMemory()->isIncremental() && localizationThreshold > 0.0)
@@ -889,6 +914,11 @@ CoreWrapper::~CoreWrapper()
 		}
 	}
 
+	if(!mapCachePath_.empty())
+	{
+		mapsManager_.saveCache(mapCachePath_, mapCacheDatabaseId());
+	}
+
 	rtabmap_.close();
 	printf("rtabmap: Saving database/long-term memory...done! (located at %s, %ld MB)\n", databasePath_.c_str(), UFile::length(databasePath_)/(1024*1024));
 
@@ -931,6 +961,9 @@ void CoreWrapper::publishLoop(double tfDelay, double tfTolerance)
 {
 	if(tfDelay == 0)
 		return;
+	std::string schedulingStatus = tfThreadScheduling_.apply();
+	NODELET_INFO("rtabmap: TF thread scheduling: %s", schedulingStatus.c_str());
+	threadSchedulingDiagnostic_.setStatus("TF thread", schedulingStatus);
 	ros::Rate r(1.0 / tfDelay);
 	while(tfThreadRunning_)
 	{
@@ -952,6 +985,7 @@ void CoreWrapper::publishLoop(double tfDelay, double tfTolerance)
 
 void CoreWrapper::defaultCallback(const sensor_msgs::ImageConstPtr & imageMsg)
 {
+	callbackThreadsScheduling_.applyToCurrentThread();
 	if(!paused_)
 	{
 		ros::Time stamp = imageMsg->header.stamp;
@@ -1202,6 +1236,7 @@ void CoreWrapper::commonMultiCameraCallback(
 		const std::vector<std::vector<rtabmap_msgs::Point3f> > & localPoints3d,
 		const std::vector<cv::Mat> & localDescriptors)
 {
+	callbackThreadsScheduling_.applyToCurrentThread();
 	std::string odomFrameId = odomFrameId_;
 	if(odomMsg.get())
 	{
@@ -1567,6 +1602,7 @@ void CoreWrapper::commonLaserScanCallback(
 		const rtabmap_msgs::OdomInfoConstPtr& odomInfoMsg,
 		const rtabmap_msgs::GlobalDescriptor & globalDescriptor)
 {
+	callbackThreadsScheduling_.applyToCurrentThread();
 	UTimer timerConversion;
 	std::string odomFrameId = odomFrameId_;
 	if(odomMsg.get())
@@ -1702,6 +1738,7 @@ void CoreWrapper::commonOdomCallback(
 		const rtabmap_msgs::UserDataConstPtr & userDataMsg,
 		const rtabmap_msgs::OdomInfoConstPtr& odomInfoMsg)
 {
+	callbackThreadsScheduling_.applyToCurrentThread();
 	UTimer timerConversion;
 	UASSERT(odomMsg.get());
 	std::string odomFrameId = odomFrameId_;
@@ -1761,6 +1798,7 @@ void CoreWrapper::commonSensorDataCallback(
 		const nav_msgs::OdometryConstPtr & odomMsg,
 		const rtabmap_msgs::OdomInfoConstPtr& odomInfoMsg)
 {
+	callbackThreadsScheduling_.applyToCurrentThread();
 	UTimer timerConversion;
 	UASSERT(sensorDataMsg.get());
 	std::string odomFrameId = odomFrameId_;
@@ -1777,7 +1815,16 @@ void CoreWrapper::commonSensorDataCallback(
 		return;
 	}
 
-	SensorData data = rtabmap_conversions::sensorDataFromROS(*sensorDataMsg);
+	SensorData data;
+	if(sensorDataMsg->left.data.empty() && sensorDataMsg->right.data.empty() && sensorDataMsg->laser_scan.data.empty())
+	{
+		// compressed only, reference the message instead of copying the payloads
+		data = rtabmap_conversions::sensorDataFromROS(sensorDataMsg);
+	}
+	else
+	{
+		data = rtabmap_conversions::sensorDataFromROS(*sensorDataMsg);
+	}
 	data.setId(lastPoseIntermediate_?-1:0);
 
 	OdometryInfo odomInfo;
@@ -2182,7 +2229,7 @@ void CoreWrapper::process(
 
 				timeUpdateMaps = timer.ticks();
 
-				mapsManager_.publishMaps(filteredPoses, stamp, mapFrameId_);
+				mapsManager_.publishMaps(filteredPoses, stamp, mapFrameId_, mapToOdom_*odom);
 
 				// Publish local graph, info
 				this->publishStats(stamp);
@@ -2305,6 +2352,7 @@ void CoreWrapper::process(
 		rtabmapROSStats_.insert(std::make_pair(std::string("RtabmapROS/TimeUpdatingMaps/ms"), timeUpdateMaps*1000.0f));
 		rtabmapROSStats_.insert(std::make_pair(std::string("RtabmapROS/TimePublishing/ms"), timePublishMaps*1000.0f));
 		rtabmapROSStats_.insert(std::make_pair(std::string("RtabmapROS/TimeTotal/ms"), (timeMsgConversion+timeRtabmap+timeUpdateMaps+timePublishMaps)*1000.0f));
+		rtabmapROSStats_.insert(mapsManager_.getStatistics().begin(), mapsManager_.getStatistics().end());
 	}
 	else if(!rtabmap_.isIDsGenerated())
 	{
@@ -2469,6 +2517,7 @@ void CoreWrapper::fiducialDetectionsAsyncCallback(const fiducial_msgs::FiducialT
 
 void CoreWrapper::imuAsyncCallback(const sensor_msgs::ImuConstPtr & msg)
 {
+	callbackThreadsScheduling_.applyToCurrentThread();
 	if(!paused_)
 	{
 		if(msg->orientation.x == 0 && msg->orientation.y == 0 && msg->orientation.z == 0 && msg->orientation.w == 0)
@@ -2796,6 +2845,7 @@ bool CoreWrapper::resetRtabmapCallback(std_srvs::Empty::Request&, std_srvs::Empt
 {
 	NODELET_INFO("rtabmap: Reset");
 	rtabmap_.resetMemory();
+	mapCacheDatabaseIdOnInit_ = databaseIdentity();
 	covariance_ = cv::Mat();
 	lastPose_.setIdentity();
 	lastPoseVelocity_.clear();
@@ -2945,6 +2995,7 @@ bool CoreWrapper::loadDatabaseCallback(rtabmap_msgs::LoadDatabase::Request& req,
 
 	NODELET_INFO("LoadDatabase: Loading database...");
 	rtabmap_.init(parameters_, databasePath_);
+	mapCacheDatabaseIdOnInit_ = databaseIdentity();
 	NODELET_INFO("LoadDatabase: Loading database... done!");
 
 	if(rtabmap_.getMemory())
@@ -2994,6 +3045,39 @@ bool CoreWrapper::triggerNewMapCallback(std_srvs::Empty::Request&, std_srvs::Emp
 	return true;
 }
 
+bool CoreWrapper::saveMapCacheCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&)
+{
+	if(mapCachePath_.empty())
+	{
+		NODELET_ERROR("Cannot save map cache, parameter \"map_cache_path\" is not set.");
+		return false;
+	}
+	return mapsManager_.saveCache(mapCachePath_, mapCacheDatabaseId());
+}
+
+std::string CoreWrapper::databaseIdentity() const
+{
+	// Database path with its last node, so that a cache of a deleted or
+	// another database at the same path is not loaded.
+	if(!rtabmap_.getMemory())
+	{
+		return databasePath_;
+	}
+	int lastId = rtabmap_.getMemory()->getLastSignatureId();
+	const Signature * s = rtabmap_.getMemory()->getSignature(lastId);
+	return uFormat("%s:%d:%f", databasePath_.c_str(), lastId, s?s->getStamp():0.0);
+}
+
+std::string CoreWrapper::mapCacheDatabaseId() const
+{
+	if(rtabmap_.getMemory() && !rtabmap_.getMemory()->isIncremental())
+	{
+		// New nodes are not saved in localization mode, the database is the same as on init
+		return mapCacheDatabaseIdOnInit_;
+	}
+	return databaseIdentity();
+}
+
 bool CoreWrapper::backupDatabaseCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&)
 {
 	NODELET_INFO("Backup: Saving memory...");
@@ -3032,6 +3116,7 @@ bool CoreWrapper::backupDatabaseCallback(std_srvs::Empty::Request&, std_srvs::Em
 
 	NODELET_INFO("Backup: Reloading memory...");
 	rtabmap_.init(parameters_, databasePath_);
+	mapCacheDatabaseIdOnInit_ = databaseIdentity();
 	NODELET_INFO("Backup: Reloading memory... done!");
 
 	return true;
@@ -3040,7 +3125,7 @@ bool CoreWrapper::backupDatabaseCallback(std_srvs::Empty::Request&, std_srvs::Em
 void CoreWrapper::republishMaps()
 {
 	ros::Time stamp = ros::Time::now();
-	mapsManager_.publishMaps(rtabmap_.getLocalOptimizedPoses(), stamp, mapFrameId_);
+	mapsManager_.publishMaps(rtabmap_.getLocalOptimizedPoses(), stamp, mapFrameId_, Transform(), true);
 
 	if(mapDataPub_.getNumSubscribers())
 	{
@@ -3308,7 +3393,7 @@ bool CoreWrapper::getNodeDataCallback(rtabmap_msgs::GetNodeData::Request& req, r
 		if(s.id()>0)
 		{
 			rtabmap_msgs::Node msg;
-			rtabmap_conversions::nodeToROS(s, msg);
+			rtabmap_conversions::nodeToROS(s, msg, packedFeatures_);
 			res.data.push_back(msg);
 		}
 	}
@@ -3342,7 +3427,8 @@ bool CoreWrapper::getMapDataCallback(rtabmap_msgs::GetMap::Request& req, rtabmap
 		constraints,
 		signatures,
 		mapToOdom_,
-		res.data);
+		res.data,
+		packedFeatures_);
 
 	res.data.header.stamp = ros::Time::now();
 	res.data.header.frame_id = mapFrameId_;
@@ -3381,7 +3467,8 @@ bool CoreWrapper::getMapData2Callback(rtabmap_msgs::GetMap2::Request& req, rtabm
 		constraints,
 		signatures,
 		mapToOdom_,
-		res.data);
+		res.data,
+		packedFeatures_);
 
 	res.data.header.stamp = ros::Time::now();
 	res.data.header.frame_id = mapFrameId_;
@@ -3530,7 +3617,8 @@ bool CoreWrapper::publishMapCallback(rtabmap_msgs::PublishMap::Request& req, rta
 				constraints,
 				signatures,
 				mapToOdom_,
-				*msg);
+				*msg,
+				packedFeatures_);
 
 			mapDataPub_.publish(msg);
 		}
@@ -3619,7 +3707,7 @@ bool CoreWrapper::publishMapCallback(rtabmap_msgs::PublishMap::Request& req, rta
 				{
 					filteredPoses = mapsManager_.getFilteredPoses(filteredPoses);
 				}
-				mapsManager_.publishMaps(filteredPoses, now, mapFrameId_);
+				mapsManager_.publishMaps(filteredPoses, now, mapFrameId_, Transform(), true);
 			}
 			else
 			{
@@ -4077,7 +4165,8 @@ void CoreWrapper::publishStats(const ros::Time & stamp)
 			stats.constraints(),
 			stats.getSignaturesData(),
 			stats.mapCorrection(),
-			*msg);
+			*msg,
+			packedFeatures_);
 
 		mapDataPub_.publish(msg);
 	}
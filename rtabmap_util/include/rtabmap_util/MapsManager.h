@@ -32,10 +32,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/Parameters.h>
 #include <rtabmap/core/FlannIndex.h>
 #include <rtabmap/core/LocalGrid.h>
+#include <rtabmap/utilite/UMutex.h>
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <ros/time.h>
 #include <ros/publisher.h>
+#include <ros/single_subscriber_publisher.h>
+#include <rtabmap_msgs/MapTile.h>
+
+#include <set>
 
 namespace rtabmap {
 class OctoMap;
@@ -71,10 +76,16 @@ public:
 			bool updateOctomap,
 			const std::map<int, rtabmap::Signature> & signatures = std::map<int, rtabmap::Signature>());
 
+	/**
+	 * @param currentPose center of the local window, if null, the latest pose in "poses" is used.
+	 * @param forceGlobalPublication publish global maps even if "map_global_publish_rate" period is not elapsed.
+	 */
 	void publishMaps(
 			const std::map<int, rtabmap::Transform> & poses,
 			const ros::Time & stamp,
-			const std::string & mapFrameId);
+			const std::string & mapFrameId,
+			const rtabmap::Transform & currentPose = rtabmap::Transform(),
+			bool forceGlobalPublication = false);
 
 	cv::Mat getGridMap(
 			float & xMin,
@@ -90,6 +101,47 @@ public:
 	const rtabmap::OccupancyGrid * getOccupancyGrid() const {return occupancyGrid_;}
 	const rtabmap::LocalGridMaker * getLocalMapMaker() const {return localMapMaker_;}
 
+	/**
+	 * Save local grids, occupancy grid and assembled clouds (with the poses
+	 * used to create them) to a file, to avoid regenerating them on next start.
+	 */
+	bool saveCache(const std::string & path, const std::string & databaseId) const;
+	/**
+	 * Load caches saved with saveCache(). The cache is ignored if "databaseId" is not
+	 * the one it was saved with. Local grids of nodes still in the graph are always
+	 * restored. The occupancy grid and assembled clouds are restored only if
+	 * their poses still match "poses".
+	 */
+	bool loadCache(const std::string & path, const std::map<int, rtabmap::Transform> & poses, const std::string & databaseId);
+
+	// Timings (ms) of the last updateMapCaches() call, ready to be added to RTAB-Map's statistics
+	const std::map<std::string, float> & getStatistics() const {return statistics_;}
+
+private:
+	bool isUpdateDue(double rate, const ros::WallTime & lastUpdate) const;
+	void updateGlobalGrid(const std::map<int, rtabmap::Transform> & poses);
+	void updateGlobalOctomap(const std::map<int, rtabmap::Transform> & poses);
+	void updateGlobalElevationMap(const std::map<int, rtabmap::Transform> & poses);
+	void publishLocalMaps(
+			const std::map<int, rtabmap::Transform> & poses,
+			const ros::Time & stamp,
+			const std::string & mapFrameId,
+			const rtabmap::Transform & center);
+	void updateOctomapDerivedClouds();
+	void addCloudMapTilesPoints(
+			const pcl::PointCloud<pcl::PointXYZRGB> & cloud,
+			bool ground,
+			std::set<std::pair<int, int> > & touchedTiles);
+	void rebuildCloudMapTiles();
+	struct CloudMapTile;
+	rtabmap_msgs::MapTilePtr createCloudMapTileMsg(
+			const std::pair<int, int> & key,
+			const CloudMapTile & tile) const;
+	void publishCloudMapTiles(
+			const ros::Time & stamp,
+			const std::string & mapFrameId);
+	void cloudMapTilesConnectCallback(const ros::SingleSubscriberPublisher & pub);
+
 private:
 	// mapping stuff
 	bool cloudOutputVoxelized_;
@@ -117,6 +169,10 @@ private:
 	ros::Publisher octoMapEmptySpace_;
 	ros::Publisher octoMapProj_;
 	ros::Publisher elevationMapPub_;
+	ros::Publisher cloudMapLocalPub_;
+	ros::Publisher gridMapLocalPub_;
+	ros::Publisher cloudMapTilesPub_;
+	ros::Publisher cloudMapTileIndexPub_;
 
 	std::map<int, rtabmap::Transform> assembledGroundPoses_;
 	std::map<int, rtabmap::Transform> assembledObstaclePoses_;
@@ -130,6 +186,7 @@ private:
 	rtabmap::LocalGridCache localMaps_;
 
 	rtabmap::OccupancyGrid * occupancyGrid_;
+	rtabmap::OccupancyGrid * localOccupancyGrid_; // only nodes around the local window
 	rtabmap::LocalGridMaker * localMapMaker_;
 	bool gridUpdated_;
 
@@ -137,9 +194,53 @@ private:
 	int octomapTreeDepth_;
 	bool octomapUpdated_;
 
+	// Frontier and empty space clouds maintained from the regions touched by the latest insertions
+	bool octomapIncrementalFrontier_;
+	bool octomapDerivedFullUpdate_;
+	std::vector<std::pair<cv::Point3f, cv::Point3f> > octomapTouchedBoxes_;
+	std::map<unsigned long long, pcl::PointXYZRGB> octomapFrontierCells_;
+	std::map<unsigned long long, pcl::PointXYZRGB> octomapEmptyCells_;
+
 	rtabmap::GridMap * elevationMap_;
 	bool elevationMapUpdated_;
 
+	bool parallelUpdate_;
+	double gridUpdateRate_;
+	double octomapUpdateRate_;
+	double elevationMapUpdateRate_;
+	ros::WallTime lastGridUpdate_;
+	ros::WallTime lastOctomapUpdate_;
+	ros::WallTime lastElevationMapUpdate_;
+	double gridUpdateTime_;
+	double octomapUpdateTime_;
+	double elevationMapUpdateTime_;
+	std::map<std::string, float> statistics_;
+
+	double localWindowRadius_;
+	double globalPublishRate_;
+	ros::WallTime lastGlobalPublication_;
+	bool globalCloudsPending_;
+	bool globalGridPending_;
+	bool globalOctomapPending_;
+	bool globalElevationMapPending_;
+
+	double cloudMapTileSize_;
+	struct CloudMapTile
+	{
+		CloudMapTile() : version(1), dirty(true) {}
+		pcl::PointCloud<pcl::PointXYZRGB> obstacles;
+		pcl::PointCloud<pcl::PointXYZRGB> ground;
+		unsigned int version;
+		bool dirty; // not published since last change
+	};
+	// Tiles are updated with the clouds added to the assembled clouds,
+	// they are rebuilt only when the assembled clouds are regenerated.
+	std::map<std::pair<int, int>, CloudMapTile> cloudMapTiles_;
+	bool cloudMapTilesValid_;
+	bool cloudMapTilesRemoved_;
+	std_msgs::Header cloudMapTilesHeader_; // of the last publication
+	UMutex cloudMapTilesMutex_; // tiles are also sent from the connect callback
+
 	rtabmap::ParametersMap parameters_;
 
 	bool latching_;
@@ -0,0 +1,251 @@
+/*
+Copyright (c) 2010-2022, Mathieu Labbe
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef RTABMAP_UTIL_THREADSCHEDULING_H_
+#define RTABMAP_UTIL_THREADSCHEDULING_H_
+
+#include <ros/ros.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UMutex.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+namespace rtabmap_util {
+
+/**
+ * Scheduling of a thread, read from parameters "<prefix>_name",
+ * "<prefix>_cpus" (e.g., "2,3"), "<prefix>_nice" and "<prefix>_priority"
+ * (>0 for SCHED_FIFO). Values of 0 or empty keep the default.
+ */
+struct ThreadScheduling
+{
+	ThreadScheduling(const std::string & defaultName = "") :
+		name(defaultName),
+		nice(0),
+		priority(0)
+	{}
+
+	void load(const ros::NodeHandle & pnh, const std::string & prefix)
+	{
+		std::string cpusStr;
+		pnh.param(prefix+"_name", name, name);
+		pnh.param(prefix+"_cpus", cpusStr, cpusStr);
+		pnh.param(prefix+"_nice", nice, nice);
+		pnh.param(prefix+"_priority", priority, priority);
+		cpus.clear();
+		std::list<std::string> values = uSplit(cpusStr, ',');
+		for(std::list<std::string>::iterator iter=values.begin(); iter!=values.end(); ++iter)
+		{
+			if(!iter->empty())
+			{
+				cpus.push_back(uStr2Int(*iter));
+			}
+		}
+		ROS_INFO("%s: name=%s cpus=\"%s\" nice=%d priority=%d", prefix.c_str(), name.c_str(), cpusStr.c_str(), nice, priority);
+	}
+
+	// Apply to the calling thread. Returns the settings actually applied.
+	std::string apply() const
+	{
+		std::string status;
+#ifdef __linux__
+		pthread_t thread = pthread_self();
+		if(!name.empty())
+		{
+			// limited to 15 characters
+			pthread_setname_np(thread, name.substr(0, 15).c_str());
+		}
+		if(!cpus.empty())
+		{
+			cpu_set_t cpuset;
+			CPU_ZERO(&cpuset);
+			int validCpus = 0;
+			for(size_t i=0; i<cpus.size(); ++i)
+			{
+				if(cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+				{
+					CPU_SET(cpus[i], &cpuset);
+					++validCpus;
+				}
+				else
+				{
+					ROS_WARN("Thread \"%s\": CPU %d is out of range [0,%d[, ignored.", name.c_str(), cpus[i], CPU_SETSIZE);
+				}
+			}
+			if(validCpus == 0)
+			{
+				ROS_WARN("Thread \"%s\": no valid CPU, affinity not changed.", name.c_str());
+			}
+			else if(pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset) != 0)
+			{
+				ROS_WARN("Thread \"%s\": failed to set CPU affinity.", name.c_str());
+			}
+		}
+		if(nice != 0)
+		{
+			// on Linux, nice value is per thread
+			if(setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice) != 0)
+			{
+				ROS_WARN("Thread \"%s\": failed to set nice value %d (permissions?).", name.c_str(), nice);
+			}
+		}
+		if(priority > 0)
+		{
+			sched_param param;
+			param.sched_priority = priority;
+			if(pthread_setschedparam(thread, SCHED_FIFO, &param) != 0)
+			{
+				ROS_WARN("Thread \"%s\": failed to set SCHED_FIFO priority %d (permissions?).", name.c_str(), priority);
+			}
+		}
+
+		// read back actual settings
+		char threadName[16] = {0};
+		pthread_getname_np(thread, threadName, sizeof(threadName));
+		std::string cpusApplied;
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		if(pthread_getaffinity_np(thread, sizeof(cpu_set_t), &cpuset) == 0)
+		{
+			for(int i=0; i<CPU_SETSIZE; ++i)
+			{
+				if(CPU_ISSET(i, &cpuset))
+				{
+					cpusApplied += (cpusApplied.empty()?"":",") + uNumber2Str(i);
+				}
+			}
+		}
+		int policy = 0;
+		sched_param param;
+		pthread_getschedparam(thread, &policy, &param);
+		status = uFormat("name=%s cpus=%s nice=%d policy=%s priority=%d",
+				threadName,
+				cpusApplied.c_str(),
+				getpriority(PRIO_PROCESS, syscall(SYS_gettid)),
+				policy==SCHED_FIFO?"fifo":policy==SCHED_RR?"rr":"other",
+				param.sched_priority);
+#else
+		status = "not supported on this platform";
+#endif
+		return status;
+	}
+
+	std::string name;
+	std::vector<int> cpus;
+	int nice;
+	int priority;
+
+	bool isDefault() const {return name.empty() && cpus.empty() && nice == 0 && priority <= 0;}
+};
+
+// Reports scheduling applied to threads
+class ThreadSchedulingTask : public diagnostic_updater::DiagnosticTask
+{
+public:
+	ThreadSchedulingTask() :
+		diagnostic_updater::DiagnosticTask("Thread scheduling")
+	{}
+	void setStatus(const std::string & thread, const std::string & status)
+	{
+		UScopeMutex lock(mutex_);
+		status_[thread] = status;
+	}
+	void run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+	{
+		UScopeMutex lock(mutex_);
+		stat.summary(diagnostic_msgs::DiagnosticStatus::OK, status_.empty()?"Default":"Applied");
+		for(std::map<std::string, std::string>::iterator iter=status_.begin(); iter!=status_.end(); ++iter)
+		{
+			stat.add(iter->first, iter->second);
+		}
+	}
+private:
+	UMutex mutex_;
+	std::map<std::string, std::string> status_;
+};
+
+/**
+ * Scheduling of callback worker threads (e.g., of the nodelet loader or
+ * manager). We don't create these threads, so the scheduling is applied
+ * from the first callback called on each one of them. Applying it to the
+ * main thread instead would be inherited by all threads created after.
+ */
+class CallbackThreadsScheduling
+{
+public:
+	CallbackThreadsScheduling() :
+		task_(0)
+	{}
+	void load(const ros::NodeHandle & pnh, const std::string & prefix, ThreadSchedulingTask * task)
+	{
+		UScopeMutex lock(mutex_);
+		scheduling_.load(pnh, prefix);
+		task_ = task;
+		threads_.clear();
+	}
+	// To call at the beginning of callbacks
+	void applyToCurrentThread()
+	{
+		if(scheduling_.isDefault())
+		{
+			return;
+		}
+		UScopeMutex lock(mutex_);
+		if(threads_.insert(boost::this_thread::get_id()).second)
+		{
+			std::string status = scheduling_.apply();
+			ROS_INFO("Callback thread %d scheduling: %s", (int)threads_.size(), status.c_str());
+			if(task_)
+			{
+				task_->setStatus(uFormat("Callback thread %d", (int)threads_.size()), status);
+			}
+		}
+	}
+private:
+	UMutex mutex_;
+	ThreadScheduling scheduling_;
+	ThreadSchedulingTask * task_;
+	std::set<boost::thread::id> threads_;
+};
+
+}
+
+#endif /* RTABMAP_UTIL_THREADSCHEDULING_H_ */
@@ -582,13 +582,17 @@ int main(int argc, char** argv)
 				uint32_t rangesSize = std::ceil((msg.angle_max - msg.angle_min) / msg.angle_increment);
 				msg.ranges.assign(rangesSize, 0.0);
 
+				// Check squared range first so that sqrt/atan2 are done only on valid points
 				const cv::Mat & scan = odom.data().laserScanRaw().data();
+				float rangeMinSqr = msg.range_min*msg.range_min;
+				float rangeMaxSqr = msg.range_max*msg.range_max;
 				for (int i=0; i<scan.cols; ++i)
 				{
 					const float * ptr = scan.ptr<float>(0,i);
-					double range = hypot(ptr[0], ptr[1]);
-					if (range >= msg.range_min && range <=msg.range_max)
+					float rangeSqr = ptr[0]*ptr[0] + ptr[1]*ptr[1];
+					if (rangeSqr >= rangeMinSqr && rangeSqr <= rangeMaxSqr)
 					{
+						double range = sqrt(rangeSqr);
 						double angle = atan2(ptr[1], ptr[0]);
 						if (angle >= msg.angle_min && angle <= msg.angle_max)
 						{
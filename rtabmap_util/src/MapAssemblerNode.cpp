@@ -255,18 +255,26 @@ public:
 		std::multimap<int, Link> constraints;
 		Transform mapOdom;
 		rtabmap_conversions::mapGraphFromROS(msg.graph, poses, constraints, mapOdom);
+		std::vector<int> indices;
 		for(unsigned int i=0; i<msg.nodes.size(); ++i)
 		{
 			if(msg.nodes[i].data.left_compressed.size() ||
 			   msg.nodes[i].data.right_compressed.size() ||
 			   msg.nodes[i].data.laser_scan_compressed.size())
 			{
-				Signature data = rtabmap_conversions::nodeFromROS(msg.nodes[i]);
+				indices.push_back(i);
+			}
+		}
+		if(!indices.empty())
+		{
+			std::vector<Signature> nodes = rtabmap_conversions::nodesFromROS(msg.nodes, indices);
+			for(unsigned int i=0; i<nodes.size(); ++i)
+			{
 				if(localGridsRegenerated_)
 				{
-					data.sensorData().setOccupancyGrid(cv::Mat(), cv::Mat(), cv::Mat(), 0, cv::Point3f());
+					nodes[i].sensorData().setOccupancyGrid(cv::Mat(), cv::Mat(), cv::Mat(), 0, cv::Point3f());
 				}
-				uInsert(nodes_, std::make_pair(msg.nodes[i].id, data));
+				uInsert(nodes_, std::make_pair(msg.nodes[indices[i]].id, nodes[i]));
 			}
 		}
 
@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/core/util3d.h>
 #include <rtabmap/core/util3d_mapping.h>
 #include <rtabmap/core/util3d_filtering.h>
 #include <rtabmap/core/util3d_transforms.h>
@@ -41,11 +42,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pcl/search/kdtree.h>
 
 #include <nav_msgs/OccupancyGrid.h>
+#include <rtabmap_msgs/MapTile.h>
+#include <rtabmap_msgs/MapTileIndex.h>
 #include <ros/ros.h>
+#include <boost/thread.hpp>
 
 #include <pcl_conversions/pcl_conversions.h>
 #include <rtabmap/core/LocalGridMaker.h>
 
+#include <fstream>
+
 #if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
 #include <octomap_msgs/conversions.h>
 #include <octomap/ColorOcTree.h>
@@ -73,6 +79,7 @@ MapsManager::MapsManager() :
 		assembledObstacles_(new pcl::PointCloud<pcl::PointXYZRGB>),
 		assembledGround_(new pcl::PointCloud<pcl::PointXYZRGB>),
 		occupancyGrid_(new OccupancyGrid(&localMaps_)),
+		localOccupancyGrid_(new OccupancyGrid(&localMaps_)),
 		localMapMaker_(new LocalGridMaker),
 		gridUpdated_(true),
 #if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
@@ -82,12 +89,30 @@ MapsManager::MapsManager() :
 #endif
 		octomapTreeDepth_(16),
 		octomapUpdated_(true),
+		octomapIncrementalFrontier_(true),
+		octomapDerivedFullUpdate_(true),
 #if defined(WITH_GRID_MAP_ROS) and defined(RTABMAP_GRIDMAP)
 		elevationMap_(new GridMap(&localMaps_)),
 #else
 		elevationMap_(0),
 #endif
 		elevationMapUpdated_(true),
+		parallelUpdate_(true),
+		gridUpdateRate_(0.0),
+		octomapUpdateRate_(0.0),
+		elevationMapUpdateRate_(0.0),
+		gridUpdateTime_(0.0),
+		octomapUpdateTime_(0.0),
+		elevationMapUpdateTime_(0.0),
+		localWindowRadius_(0.0),
+		globalPublishRate_(0.0),
+		globalCloudsPending_(false),
+		globalGridPending_(false),
+		globalOctomapPending_(false),
+		globalElevationMapPending_(false),
+		cloudMapTileSize_(0.0),
+		cloudMapTilesValid_(false),
+		cloudMapTilesRemoved_(false),
 		latching_(true)
 {
 }
@@ -145,6 +170,29 @@ void MapsManager::init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::s
 	ROS_INFO("%s(maps): cloud_subtract_filtering   = %s", name.c_str(), cloudSubtractFiltering_?"true":"false");
 	ROS_INFO("%s(maps): cloud_subtract_filtering_min_neighbors = %d", name.c_str(), cloudSubtractFilteringMinNeighbors_);
 
+	// Grid, OctoMap and elevation map are updated from the same local grids, they
+	// can be updated concurrently. Update rates (Hz) are only applied when maps
+	// are updated because of subscribers (0=updated on each map update).
+	pnh.param("map_parallel_update", parallelUpdate_, parallelUpdate_);
+	pnh.param("map_grid_update_rate", gridUpdateRate_, gridUpdateRate_);
+	pnh.param("map_octomap_update_rate", octomapUpdateRate_, octomapUpdateRate_);
+	pnh.param("map_elevation_update_rate", elevationMapUpdateRate_, elevationMapUpdateRate_);
+	ROS_INFO("%s(maps): map_parallel_update        = %s", name.c_str(), parallelUpdate_?"true":"false");
+	ROS_INFO("%s(maps): map_grid_update_rate       = %f", name.c_str(), gridUpdateRate_);
+	ROS_INFO("%s(maps): map_octomap_update_rate    = %f", name.c_str(), octomapUpdateRate_);
+	ROS_INFO("%s(maps): map_elevation_update_rate  = %f", name.c_str(), elevationMapUpdateRate_);
+
+	// Local window maps (cloud_map_local, grid_map_local) are published on each
+	// map update, while global maps can be published at lower rate (0=on each map update).
+	pnh.param("map_local_radius", localWindowRadius_, localWindowRadius_);
+	pnh.param("map_global_publish_rate", globalPublishRate_, globalPublishRate_);
+	ROS_INFO("%s(maps): map_local_radius           = %f", name.c_str(), localWindowRadius_);
+	ROS_INFO("%s(maps): map_global_publish_rate    = %f", name.c_str(), globalPublishRate_);
+
+	// Partition cloud_map in spatial tiles of this size (m), only changed tiles are sent on cloud_map_tiles
+	pnh.param("cloud_map_tile_size", cloudMapTileSize_, cloudMapTileSize_);
+	ROS_INFO("%s(maps): cloud_map_tile_size        = %f", name.c_str(), cloudMapTileSize_);
+
 #if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
     pnh.param("octomap_tree_depth", octomapTreeDepth_, octomapTreeDepth_);
    	if(octomapTreeDepth_ > 16)
@@ -158,6 +206,9 @@ void MapsManager::init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::s
 		octomapTreeDepth_ = 16;
 	}
 	ROS_INFO("%s(maps): octomap_tree_depth         = %d", name.c_str(), octomapTreeDepth_);
+	// Update frontier and empty space clouds only where new clouds have been inserted (full update after graph optimization)
+	pnh.param("octomap_incremental_frontier", octomapIncrementalFrontier_, octomapIncrementalFrontier_);
+	ROS_INFO("%s(maps): octomap_incremental_frontier = %s", name.c_str(), octomapIncrementalFrontier_?"true":"false");
 #endif
 
 	// If true, the last message published on
@@ -187,6 +238,22 @@ void MapsManager::init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::s
 	cloudGroundPub_ = nht->advertise<sensor_msgs::PointCloud2>("cloud_ground", 1, latching_);
 	latched_.insert(std::make_pair((void*)&cloudGroundPub_, false));
 
+	if(localWindowRadius_ > 0.0)
+	{
+		// Not latched, they are updated continuously
+		cloudMapLocalPub_ = nht->advertise<sensor_msgs::PointCloud2>("cloud_map_local", 1);
+		gridMapLocalPub_ = nht->advertise<nav_msgs::OccupancyGrid>("grid_map_local", 1);
+	}
+
+	if(cloudMapTileSize_ > 0.0)
+	{
+		// Many tiles can be published at the same time, don't latch them, the index is latched.
+		// Unbounded queue: a tile is sent only when it changes, so a dropped one would stay stale.
+		cloudMapTilesPub_ = nht->advertise<rtabmap_msgs::MapTile>("cloud_map_tiles", 0,
+				boost::bind(&MapsManager::cloudMapTilesConnectCallback, this, _1));
+		cloudMapTileIndexPub_ = nht->advertise<rtabmap_msgs::MapTileIndex>("cloud_map_tile_index", 1, true);
+	}
+
 	// deprecated
 	projMapPub_ = nht->advertise<nav_msgs::OccupancyGrid>("proj_map", 1, latching_);
 	latched_.insert(std::make_pair((void*)&projMapPub_, false));
@@ -222,6 +289,7 @@ MapsManager::~MapsManager() {
 	clear();
 
 	delete occupancyGrid_;
+	delete localOccupancyGrid_;
 	delete localMapMaker_;
 
 #if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
@@ -331,6 +399,10 @@ void MapsManager::setParameters(const rtabmap::ParametersMap & parameters)
 	parameters_ = parameters;
 	delete occupancyGrid_;
 	occupancyGrid_ = new OccupancyGrid(&localMaps_, parameters_);
+	delete localOccupancyGrid_;
+	ParametersMap localParameters = parameters_;
+	uInsert(localParameters, ParametersPair(Parameters::kGridGlobalMinSize(), "0"));
+	localOccupancyGrid_ = new OccupancyGrid(&localMaps_, localParameters);
 	
 	localMapMaker_->parseParameters(parameters_);
 
@@ -399,9 +471,14 @@ void MapsManager::clear()
 	groundClouds_.clear();
 	obstacleClouds_.clear();
 	occupancyGrid_->clear();
+	localOccupancyGrid_->clear();
 #if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
 	octomap_->clear();
 #endif
+	octomapDerivedFullUpdate_ = true;
+	octomapTouchedBoxes_.clear();
+	octomapFrontierCells_.clear();
+	octomapEmptyCells_.clear();
 #if defined(WITH_GRID_MAP_ROS) and defined(RTABMAP_GRIDMAP)
 	elevationMap_->clear();
 #endif
@@ -409,6 +486,20 @@ void MapsManager::clear()
 	{
 		iter->second = false;
 	}
+	lastGridUpdate_ = ros::WallTime();
+	lastOctomapUpdate_ = ros::WallTime();
+	lastElevationMapUpdate_ = ros::WallTime();
+	statistics_.clear();
+	lastGlobalPublication_ = ros::WallTime();
+	globalCloudsPending_ = false;
+	globalGridPending_ = false;
+	globalOctomapPending_ = false;
+	globalElevationMapPending_ = false;
+	// subscribers should drop the tiles already received
+	UScopeMutex lock(cloudMapTilesMutex_);
+	cloudMapTilesRemoved_ = cloudMapTilesRemoved_ || !cloudMapTiles_.empty();
+	cloudMapTiles_.clear();
+	cloudMapTilesValid_ = false;
 }
 
 bool MapsManager::hasSubscribers() const
@@ -428,7 +519,10 @@ bool MapsManager::hasSubscribers() const
 			octoMapGroundCloud_.getNumSubscribers() != 0 ||
 			octoMapEmptySpace_.getNumSubscribers() != 0 ||
 			octoMapProj_.getNumSubscribers() != 0 ||
-			elevationMapPub_.getNumSubscribers() != 0;
+			elevationMapPub_.getNumSubscribers() != 0 ||
+			cloudMapLocalPub_.getNumSubscribers() != 0 ||
+			gridMapLocalPub_.getNumSubscribers() != 0 ||
+			cloudMapTilesPub_.getNumSubscribers() != 0;
 }
 
 bool MapsManager::isMapUpdated() const
@@ -478,7 +572,8 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 
 		updateGrid = projMapPub_.getNumSubscribers() != 0 ||
 				gridMapPub_.getNumSubscribers() != 0 ||
-				gridProbMapPub_.getNumSubscribers() != 0;
+				gridProbMapPub_.getNumSubscribers() != 0 ||
+				gridMapLocalPub_.getNumSubscribers() != 0;
 
 		updateElevation = elevationMapPub_.getNumSubscribers() != 0;
 
@@ -486,7 +581,14 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 				cloudMapPub_.getNumSubscribers() != 0 ||
 				cloudObstaclesPub_.getNumSubscribers() != 0 ||
 				cloudGroundPub_.getNumSubscribers() != 0 ||
-				scanMapPub_.getNumSubscribers() != 0;
+				scanMapPub_.getNumSubscribers() != 0 ||
+				cloudMapLocalPub_.getNumSubscribers() != 0 ||
+				cloudMapTilesPub_.getNumSubscribers() != 0;
+
+		// Throttle each map independently
+		updateGrid = updateGrid && isUpdateDue(gridUpdateRate_, lastGridUpdate_);
+		updateOctomap = updateOctomap && isUpdateDue(octomapUpdateRate_, lastOctomapUpdate_);
+		updateElevation = updateElevation && isUpdateDue(elevationMapUpdateRate_, lastElevationMapUpdate_);
 	}
 
 #if not (defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP))
@@ -502,6 +604,7 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 
 
 	UDEBUG("Updating map caches...");
+	statistics_.clear();
 
 	if(!memory && signatures.size() == 0)
 	{
@@ -564,6 +667,7 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 #endif
 		}
 
+		UTimer localGridsTimer;
 		bool occupancySavedInDB = memory && uStrNumCmp(memory->getDatabaseVersion(), "0.11.10")>=0?true:false;
 
 		for(std::map<int, rtabmap::Transform>::iterator iter=filteredPoses.begin(); iter!=filteredPoses.end(); ++iter)
@@ -686,29 +790,70 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 				ROS_ERROR("Pose null for node %d", iter->first);
 			}
 		}
+		statistics_.insert(std::make_pair(std::string("RtabmapROS/TimeUpdatingLocalGrids/ms"), localGridsTimer.ticks()*1000.0f));
+
+		gridUpdateTime_ = 0.0;
+		octomapUpdateTime_ = 0.0;
+		elevationMapUpdateTime_ = 0.0;
+		UTimer updateTimer;
+		int updates = (updateGrid?1:0) + (updateOctomap?1:0) + (updateElevation?1:0);
+		if(parallelUpdate_ && updates > 1)
+		{
+			// The maps only read the local grids cache, update them concurrently.
+			// The grid is updated on this thread.
+			boost::thread_group workers;
+			if(updateOctomap)
+			{
+				workers.create_thread(boost::bind(&MapsManager::updateGlobalOctomap, this, boost::cref(filteredPoses)));
+			}
+			if(updateElevation)
+			{
+				workers.create_thread(boost::bind(&MapsManager::updateGlobalElevationMap, this, boost::cref(filteredPoses)));
+			}
+			if(updateGrid)
+			{
+				this->updateGlobalGrid(filteredPoses);
+			}
+			workers.join_all();
+		}
+		else
+		{
+			if(updateGrid)
+			{
+				this->updateGlobalGrid(filteredPoses);
+			}
+			if(updateOctomap)
+			{
+				this->updateGlobalOctomap(filteredPoses);
+			}
+			if(updateElevation)
+			{
+				this->updateGlobalElevationMap(filteredPoses);
+			}
+		}
+		double mapsUpdateTime = updateTimer.ticks();
 
 		if(updateGrid)
 		{
-			gridUpdated_ = occupancyGrid_->update(filteredPoses);
+			lastGridUpdate_ = ros::WallTime::now();
+			statistics_.insert(std::make_pair(std::string("RtabmapROS/TimeUpdatingGrid/ms"), gridUpdateTime_*1000.0f));
 		}
-
-#if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
 		if(updateOctomap)
 		{
-			UTimer time;
-			octomapUpdated_ = octomap_->update(filteredPoses);
-			ROS_INFO("Octomap update time = %fs", time.ticks());
+			lastOctomapUpdate_ = ros::WallTime::now();
+			statistics_.insert(std::make_pair(std::string("RtabmapROS/TimeUpdatingOctomap/ms"), octomapUpdateTime_*1000.0f));
+			ROS_INFO("Octomap update time = %fs", octomapUpdateTime_);
 		}
-#endif
-
-#if defined(WITH_GRID_MAP_ROS) and defined(RTABMAP_GRIDMAP)
 		if(updateElevation)
 		{
-			UTimer time;
-			elevationMapUpdated_ = elevationMap_->update(filteredPoses);
-			ROS_INFO("GridMap (elevation map) update time = %fs", time.ticks());
+			lastElevationMapUpdate_ = ros::WallTime::now();
+			statistics_.insert(std::make_pair(std::string("RtabmapROS/TimeUpdatingElevationMap/ms"), elevationMapUpdateTime_*1000.0f));
+			ROS_INFO("GridMap (elevation map) update time = %fs", elevationMapUpdateTime_);
+		}
+		if(updates)
+		{
+			statistics_.insert(std::make_pair(std::string("RtabmapROS/TimeUpdatingGlobalMaps/ms"), mapsUpdateTime*1000.0f));
 		}
-#endif
 
 		localMaps_.clear(true);
 
@@ -747,6 +892,546 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 	return filteredPoses;
 }
 
+namespace {
+const char kCacheMagic[] = "RTABMAP_MAPS_CACHE";
+const int kCacheVersion = 2;
+
+void writeMat(std::ofstream & out, const cv::Mat & mat)
+{
+	cv::Mat m = mat.isContinuous()?mat:mat.clone();
+	int header[3] = {m.rows, m.cols, m.type()};
+	out.write((const char*)header, sizeof(header));
+	out.write((const char*)m.data, m.total()*m.elemSize());
+}
+// Bytes left to read, to validate sizes read from the file before allocating
+long long remainingBytes(std::ifstream & in, long long fileSize)
+{
+	long long pos = in.tellg();
+	return pos<0?0:fileSize - pos;
+}
+cv::Mat readMat(std::ifstream & in, long long fileSize)
+{
+	int header[3] = {0};
+	in.read((char*)header, sizeof(header));
+	cv::Mat m;
+	if(!in.good())
+	{
+		return m;
+	}
+	int type = header[2];
+	if(header[0]<0 || header[1]<0 || type<0 || type != CV_MAT_TYPE(type) || CV_MAT_DEPTH(type) > CV_64F ||
+	   (long long)header[0]*(long long)header[1]*(long long)CV_ELEM_SIZE(type) > remainingBytes(in, fileSize))
+	{
+		// corrupted
+		in.setstate(std::ios::failbit);
+		return m;
+	}
+	m = cv::Mat(header[0], header[1], type);
+	in.read((char*)m.data, m.total()*m.elemSize());
+	return m;
+}
+void writeString(std::ofstream & out, const std::string & str)
+{
+	int size = str.size();
+	out.write((const char*)&size, sizeof(int));
+	out.write(str.data(), size);
+}
+std::string readString(std::ifstream & in, long long fileSize)
+{
+	int size = 0;
+	in.read((char*)&size, sizeof(int));
+	if(!in.good() || size < 0 || size > remainingBytes(in, fileSize))
+	{
+		in.setstate(std::ios::failbit);
+		return "";
+	}
+	std::string str(size, '\0');
+	in.read(&str[0], size);
+	return str;
+}
+void writePoses(std::ofstream & out, const std::map<int, Transform> & poses)
+{
+	int size = poses.size();
+	out.write((const char*)&size, sizeof(int));
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		out.write((const char*)&iter->first, sizeof(int));
+		out.write((const char*)iter->second.data(), 12*sizeof(float));
+	}
+}
+std::map<int, Transform> readPoses(std::ifstream & in, long long fileSize)
+{
+	std::map<int, Transform> poses;
+	int size = 0;
+	in.read((char*)&size, sizeof(int));
+	if(size < 0 || (long long)size*(sizeof(int)+12*sizeof(float)) > remainingBytes(in, fileSize))
+	{
+		in.setstate(std::ios::failbit);
+		return poses;
+	}
+	for(int i=0; i<size && in.good(); ++i)
+	{
+		int id;
+		Transform t = Transform::getIdentity();
+		in.read((char*)&id, sizeof(int));
+		in.read((char*)t.data(), 12*sizeof(float));
+		poses.insert(std::make_pair(id, t));
+	}
+	return poses;
+}
+void writeClouds(std::ofstream & out, const std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > & clouds)
+{
+	int size = clouds.size();
+	out.write((const char*)&size, sizeof(int));
+	for(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::const_iterator iter=clouds.begin(); iter!=clouds.end(); ++iter)
+	{
+		int points = iter->second->size();
+		out.write((const char*)&iter->first, sizeof(int));
+		out.write((const char*)&points, sizeof(int));
+		out.write((const char*)iter->second->points.data(), points*sizeof(pcl::PointXYZRGB));
+	}
+}
+std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > readClouds(std::ifstream & in, long long fileSize)
+{
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > clouds;
+	int size = 0;
+	in.read((char*)&size, sizeof(int));
+	for(int i=0; i<size && in.good(); ++i)
+	{
+		int id, points;
+		in.read((char*)&id, sizeof(int));
+		in.read((char*)&points, sizeof(int));
+		if(!in.good() || points < 0 || (long long)points*(long long)sizeof(pcl::PointXYZRGB) > remainingBytes(in, fileSize))
+		{
+			in.setstate(std::ios::failbit);
+			break;
+		}
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+		cloud->resize(points);
+		in.read((char*)cloud->points.data(), points*sizeof(pcl::PointXYZRGB));
+		clouds.insert(std::make_pair(id, cloud));
+	}
+	return clouds;
+}
+bool posesMatch(const std::map<int, Transform> & cached, const std::map<int, Transform> & poses, float maxErrorSqr)
+{
+	for(std::map<int, Transform>::const_iterator iter=cached.begin(); iter!=cached.end(); ++iter)
+	{
+		std::map<int, Transform>::const_iterator jter = poses.find(iter->first);
+		if(jter == poses.end() || jter->second.isNull() || iter->second.getDistanceSquared(jter->second) > maxErrorSqr)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+} // namespace
+
+bool MapsManager::saveCache(const std::string & path, const std::string & databaseId) const
+{
+	UTimer time;
+	std::ofstream out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!out.is_open())
+	{
+		ROS_ERROR("MapsManager: Cannot open \"%s\" to save map cache.", path.c_str());
+		return false;
+	}
+	out.write(kCacheMagic, sizeof(kCacheMagic));
+	out.write((const char*)&kCacheVersion, sizeof(int));
+	float cellSize = occupancyGrid_->getCellSize();
+	out.write((const char*)&cellSize, sizeof(float));
+	writeString(out, databaseId);
+
+	// Local grids (independent of the graph)
+	int size = 0;
+	for(std::map<int, LocalGrid>::const_iterator iter=localMaps_.localGrids().begin(); iter!=localMaps_.localGrids().end(); ++iter)
+	{
+		size += iter->first > 0?1:0;
+	}
+	out.write((const char*)&size, sizeof(int));
+	for(std::map<int, LocalGrid>::const_iterator iter=localMaps_.localGrids().begin(); iter!=localMaps_.localGrids().end(); ++iter)
+	{
+		if(iter->first > 0)
+		{
+			out.write((const char*)&iter->first, sizeof(int));
+			out.write((const char*)&iter->second.cellSize, sizeof(float));
+			out.write((const char*)&iter->second.viewPoint, sizeof(cv::Point3f));
+			writeMat(out, iter->second.groundCells);
+			writeMat(out, iter->second.obstacleCells);
+			writeMat(out, iter->second.emptyCells);
+		}
+	}
+
+	// Occupancy grid with the poses used to create it
+	float xMin=0.0f, yMin=0.0f;
+	cv::Mat map = occupancyGrid_->getMap(xMin, yMin);
+	std::map<int, Transform> gridPoses(occupancyGrid_->addedNodes().lower_bound(1), occupancyGrid_->addedNodes().end());
+	writePoses(out, map.empty()?std::map<int, Transform>():gridPoses);
+	out.write((const char*)&xMin, sizeof(float));
+	out.write((const char*)&yMin, sizeof(float));
+	writeMat(out, map);
+
+	// Assembled clouds
+	writePoses(out, assembledGroundPoses_);
+	writeClouds(out, groundClouds_);
+	writePoses(out, assembledObstaclePoses_);
+	writeClouds(out, obstacleClouds_);
+
+	bool success = out.good();
+	out.close();
+	ROS_INFO("MapsManager: Saved map cache to \"%s\" (%d local grids, %dx%d grid, %d ground and %d obstacle clouds, %fs).",
+			path.c_str(), size, map.cols, map.rows, (int)groundClouds_.size(), (int)obstacleClouds_.size(), time.ticks());
+	return success;
+}
+
+bool MapsManager::loadCache(const std::string & path, const std::map<int, rtabmap::Transform> & poses, const std::string & databaseId)
+{
+	UTimer time;
+	std::ifstream in(path.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	if(!in.is_open())
+	{
+		return false;
+	}
+	long long fileSize = in.tellg();
+	in.seekg(0, std::ios::beg);
+	char magic[sizeof(kCacheMagic)] = {0};
+	int version = 0;
+	float cellSize = 0.0f;
+	in.read(magic, sizeof(kCacheMagic));
+	in.read((char*)&version, sizeof(int));
+	in.read((char*)&cellSize, sizeof(float));
+	if(!in.good() || memcmp(magic, kCacheMagic, sizeof(kCacheMagic)) != 0 || version != kCacheVersion)
+	{
+		ROS_WARN("MapsManager: \"%s\" is not a valid map cache, ignoring it.", path.c_str());
+		return false;
+	}
+	std::string cachedDatabaseId = readString(in, fileSize);
+	if(!in.good() || cachedDatabaseId != databaseId)
+	{
+		// Node IDs of another database would match nodes of this one
+		ROS_WARN("MapsManager: Map cache \"%s\" has been created from another database (\"%s\" vs \"%s\"), ignoring it.",
+				path.c_str(), cachedDatabaseId.c_str(), databaseId.c_str());
+		return false;
+	}
+	if(cellSize != occupancyGrid_->getCellSize())
+	{
+		ROS_WARN("MapsManager: Map cache \"%s\" has been created with a different cell size (%f vs %f), ignoring it.",
+				path.c_str(), cellSize, occupancyGrid_->getCellSize());
+		return false;
+	}
+
+	int size = 0;
+	int loadedGrids = 0;
+	in.read((char*)&size, sizeof(int));
+	for(int i=0; i<size && in.good(); ++i)
+	{
+		int id;
+		float gridCellSize;
+		cv::Point3f viewPoint;
+		in.read((char*)&id, sizeof(int));
+		in.read((char*)&gridCellSize, sizeof(float));
+		in.read((char*)&viewPoint, sizeof(cv::Point3f));
+		cv::Mat ground = readMat(in, fileSize);
+		cv::Mat obstacles = readMat(in, fileSize);
+		cv::Mat emptyCells = readMat(in, fileSize);
+		if(in.good() && poses.find(id) != poses.end())
+		{
+			localMaps_.add(id, ground, obstacles, emptyCells, gridCellSize, viewPoint);
+			++loadedGrids;
+		}
+	}
+
+	float maxErrorSqr = occupancyGrid_->getUpdateError()*occupancyGrid_->getUpdateError();
+	std::map<int, Transform> gridPoses = readPoses(in, fileSize);
+	float xMin=0.0f, yMin=0.0f;
+	in.read((char*)&xMin, sizeof(float));
+	in.read((char*)&yMin, sizeof(float));
+	cv::Mat map = readMat(in, fileSize);
+	bool gridLoaded = false;
+	if(in.good() && !map.empty() && posesMatch(gridPoses, poses, maxErrorSqr))
+	{
+		occupancyGrid_->setMap(map, xMin, yMin, cellSize, gridPoses);
+		gridLoaded = true;
+	}
+
+	std::map<int, Transform> groundPoses = readPoses(in, fileSize);
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > groundClouds = readClouds(in, fileSize);
+	std::map<int, Transform> obstaclePoses = readPoses(in, fileSize);
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > obstacleClouds = readClouds(in, fileSize);
+	bool cloudsLoaded = false;
+	if(in.good() &&
+	   posesMatch(groundPoses, poses, maxErrorSqr) &&
+	   posesMatch(obstaclePoses, poses, maxErrorSqr))
+	{
+		// Clouds are cached in node frame, assemble them back in map frame
+		assembledGround_->clear();
+		assembledObstacles_->clear();
+		for(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::iterator iter=groundClouds.begin(); iter!=groundClouds.end(); ++iter)
+		{
+			if(groundPoses.find(iter->first) != groundPoses.end())
+			{
+				*assembledGround_ += *util3d::transformPointCloud(iter->second, groundPoses.at(iter->first));
+			}
+		}
+		for(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::iterator iter=obstacleClouds.begin(); iter!=obstacleClouds.end(); ++iter)
+		{
+			if(obstaclePoses.find(iter->first) != obstaclePoses.end())
+			{
+				*assembledObstacles_ += *util3d::transformPointCloud(iter->second, obstaclePoses.at(iter->first));
+			}
+		}
+		if(cloudOutputVoxelized_)
+		{
+			if(assembledGround_->size())
+			{
+				assembledGround_ = util3d::voxelize(assembledGround_, cellSize);
+			}
+			if(assembledObstacles_->size())
+			{
+				assembledObstacles_ = util3d::voxelize(assembledObstacles_, cellSize);
+			}
+		}
+		assembledGroundPoses_ = groundPoses;
+		assembledObstaclePoses_ = obstaclePoses;
+		groundClouds_ = groundClouds;
+		obstacleClouds_ = obstacleClouds;
+		// The index for subtract filtering is rebuilt on next graph change
+		assembledGroundIndex_.release();
+		assembledObstacleIndex_.release();
+		cloudsLoaded = true;
+	}
+
+	ROS_INFO("MapsManager: Loaded map cache \"%s\" (%d/%d local grids, grid %s, clouds %s, %fs).",
+			path.c_str(), loadedGrids, size,
+			gridLoaded?"loaded":"outdated",
+			cloudsLoaded?"loaded":"outdated",
+			time.ticks());
+	return loadedGrids > 0 || gridLoaded || cloudsLoaded;
+}
+
+bool MapsManager::isUpdateDue(double rate, const ros::WallTime & lastUpdate) const
+{
+	return rate <= 0.0 || lastUpdate.isZero() || (ros::WallTime::now() - lastUpdate).toSec() >= 1.0/rate;
+}
+
+void MapsManager::updateGlobalGrid(const std::map<int, rtabmap::Transform> & poses)
+{
+	UTimer time;
+	gridUpdated_ = occupancyGrid_->update(poses);
+	gridUpdateTime_ = time.ticks();
+}
+
+void MapsManager::updateGlobalOctomap(const std::map<int, rtabmap::Transform> & poses)
+{
+#if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
+	UTimer time;
+	bool trackChanges = octomapIncrementalFrontier_ &&
+			!octomapDerivedFullUpdate_ &&
+			(octoMapFrontierCloud_.getNumSubscribers() || octoMapEmptySpace_.getNumSubscribers());
+	std::map<int, Transform> previousNodes;
+	if(trackChanges)
+	{
+		previousNodes = octomap_->addedNodes();
+	}
+
+	octomapUpdated_ = octomap_->update(poses);
+
+	if(!trackChanges)
+	{
+		octomapDerivedFullUpdate_ = true;
+		octomapTouchedBoxes_.clear();
+	}
+	else if(octomapUpdated_)
+	{
+		// If a node moved or has been removed, the octomap has been regenerated
+		const std::map<int, Transform> & nodes = octomap_->addedNodes();
+		float updateErrorSqr = octomap_->getUpdateError()*octomap_->getUpdateError();
+		for(std::map<int, Transform>::iterator iter=previousNodes.lower_bound(1); iter!=previousNodes.end() && !octomapDerivedFullUpdate_; ++iter)
+		{
+			std::map<int, Transform>::const_iterator jter = nodes.find(iter->first);
+			octomapDerivedFullUpdate_ = jter == nodes.end() || iter->second.getDistanceSquared(jter->second) > updateErrorSqr;
+		}
+
+		if(octomapDerivedFullUpdate_)
+		{
+			octomapTouchedBoxes_.clear();
+		}
+		else
+		{
+			// Bounding box of the rays of new nodes, inflated to include neighbors of changed cells
+			float margin = octomap_->getCellSize()*2.0f;
+			for(std::map<int, Transform>::const_iterator iter=nodes.begin(); iter!=nodes.end(); ++iter)
+			{
+				if(iter->first > 0 && previousNodes.find(iter->first) != previousNodes.end())
+				{
+					continue;
+				}
+				std::map<int, LocalGrid>::const_iterator jter = localMaps_.localGrids().find(iter->first);
+				if(jter == localMaps_.localGrids().end())
+				{
+					continue;
+				}
+				cv::Point3f viewPoint = util3d::transformPoint(jter->second.viewPoint, iter->second);
+				cv::Point3f min = viewPoint;
+				cv::Point3f max = viewPoint;
+				for(int i=0; i<3; ++i)
+				{
+					const cv::Mat & cells = i==0?jter->second.groundCells:i==1?jter->second.obstacleCells:jter->second.emptyCells;
+					if(cells.cols == 0)
+					{
+						continue;
+					}
+					pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = util3d::laserScanToPointCloud(LaserScan::backwardCompatibility(cells), iter->second);
+					for(unsigned int j=0; j<cloud->size(); ++j)
+					{
+						const pcl::PointXYZ & pt = cloud->at(j);
+						min.x = std::min(min.x, pt.x); max.x = std::max(max.x, pt.x);
+						min.y = std::min(min.y, pt.y); max.y = std::max(max.y, pt.y);
+						min.z = std::min(min.z, pt.z); max.z = std::max(max.z, pt.z);
+					}
+				}
+				octomapTouchedBoxes_.push_back(std::make_pair(
+						cv::Point3f(min.x-margin, min.y-margin, min.z-margin),
+						cv::Point3f(max.x+margin, max.y+margin, max.z+margin)));
+			}
+		}
+	}
+	octomapUpdateTime_ = time.ticks();
+#endif
+}
+
+#if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
+namespace {
+// Ordered by depth, then x, y and z keys, so that cells of a depth in a
+// box can be found with one range lookup per (x,y) key.
+unsigned long long octomapCellId(const octomap::OcTreeKey & key, unsigned int depth)
+{
+	return ((unsigned long long)depth << 48) |
+			((unsigned long long)key[0] << 32) |
+			((unsigned long long)key[1] << 16) |
+			(unsigned long long)key[2];
+}
+
+void addOctomapEmptyCell(
+		const RtabmapColorOcTree & octree,
+		const RtabmapColorOcTreeNode & node,
+		unsigned int depth,
+		const octomap::point3d & center,
+		std::map<unsigned long long, pcl::PointXYZRGB> & frontierCells,
+		std::map<unsigned long long, pcl::PointXYZRGB> & emptyCells)
+{
+	if(octree.isNodeOccupied(node))
+	{
+		return;
+	}
+	pcl::PointXYZRGB pt;
+	pt.x = center.x();
+	pt.y = center.y();
+	pt.z = center.z();
+	pt.r = node.getColor().r;
+	pt.g = node.getColor().g;
+	pt.b = node.getColor().b;
+	unsigned long long id = octomapCellId(octree.coordToKey(center, depth), depth);
+	emptyCells.insert(std::make_pair(id, pt));
+
+	// Frontier: empty cell with an unknown neighbor, same test as OctoMap::createCloud()
+	double offset = octree.getResolution()*2.0;
+	static const float dirs[6][3] = {{1,0,0},{-1,0,0},{0,1,0},{0,-1,0},{0,0,1},{0,0,-1}};
+	for(int i=0; i<6; ++i)
+	{
+		octomap::point3d neighbor(center.x() + dirs[i][0]*offset, center.y() + dirs[i][1]*offset, center.z() + dirs[i][2]*offset);
+		if(octree.search(neighbor) == 0)
+		{
+			frontierCells.insert(std::make_pair(id, pt));
+			break;
+		}
+	}
+}
+
+// Erase cells of any depth overlapping the box, including coarse leaves
+// with their center outside of it.
+void eraseOctomapCellsInBox(
+		const RtabmapColorOcTree & octree,
+		unsigned int maxDepth,
+		const octomap::point3d & min,
+		const octomap::point3d & max,
+		std::map<unsigned long long, pcl::PointXYZRGB> & cells)
+{
+	for(unsigned int d=0; d<=maxDepth && !cells.empty(); ++d)
+	{
+		octomap::OcTreeKey minKey = octree.coordToKey(min, d);
+		octomap::OcTreeKey maxKey = octree.coordToKey(max, d);
+		// keys of cells at depth d are spaced by their size
+		unsigned int step = 1 << (octree.getTreeDepth()-d);
+		for(unsigned int x=minKey[0]; x<=maxKey[0]; x+=step)
+		{
+			for(unsigned int y=minKey[1]; y<=maxKey[1]; y+=step)
+			{
+				octomap::OcTreeKey key(x, y, minKey[2]);
+				std::map<unsigned long long, pcl::PointXYZRGB>::iterator iter = cells.lower_bound(octomapCellId(key, d));
+				key[2] = maxKey[2];
+				unsigned long long last = octomapCellId(key, d);
+				while(iter!=cells.end() && iter->first <= last)
+				{
+					cells.erase(iter++);
+				}
+			}
+		}
+	}
+}
+} // namespace
+#endif
+
+void MapsManager::updateOctomapDerivedClouds()
+{
+#if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
+	UTimer time;
+	const RtabmapColorOcTree * octree = octomap_->octree();
+	unsigned int depth = octomapTreeDepth_;
+	if(octomapDerivedFullUpdate_)
+	{
+		octomapFrontierCells_.clear();
+		octomapEmptyCells_.clear();
+		for(RtabmapColorOcTree::leaf_iterator it = octree->begin_leafs(depth); it != octree->end_leafs(); ++it)
+		{
+			addOctomapEmptyCell(*octree, *it, it.getDepth(), it.getCoordinate(), octomapFrontierCells_, octomapEmptyCells_);
+		}
+		ROS_INFO("Octomap frontier and empty space fully updated (%d frontier, %d empty cells, %fs)",
+				(int)octomapFrontierCells_.size(), (int)octomapEmptyCells_.size(), time.ticks());
+	}
+	else
+	{
+		unsigned int maxDepth = depth==0 || depth>octree->getTreeDepth()?octree->getTreeDepth():depth;
+		for(size_t i=0; i<octomapTouchedBoxes_.size(); ++i)
+		{
+			octomap::point3d min(octomapTouchedBoxes_[i].first.x, octomapTouchedBoxes_[i].first.y, octomapTouchedBoxes_[i].first.z);
+			octomap::point3d max(octomapTouchedBoxes_[i].second.x, octomapTouchedBoxes_[i].second.y, octomapTouchedBoxes_[i].second.z);
+			eraseOctomapCellsInBox(*octree, maxDepth, min, max, octomapFrontierCells_);
+			eraseOctomapCellsInBox(*octree, maxDepth, min, max, octomapEmptyCells_);
+			// leafs overlapping the box, so the same cells as erased above
+			for(RtabmapColorOcTree::leaf_bbx_iterator it = octree->begin_leafs_bbx(min, max, depth);
+				it != octree->end_leafs_bbx(); ++it)
+			{
+				addOctomapEmptyCell(*octree, *it, it.getDepth(), it.getCoordinate(), octomapFrontierCells_, octomapEmptyCells_);
+			}
+		}
+		UDEBUG("Octomap frontier and empty space updated in %d regions (%d frontier, %d empty cells, %fs)",
+				(int)octomapTouchedBoxes_.size(), (int)octomapFrontierCells_.size(), (int)octomapEmptyCells_.size(), time.ticks());
+	}
+	octomapDerivedFullUpdate_ = false;
+	octomapTouchedBoxes_.clear();
+#endif
+}
+
+void MapsManager::updateGlobalElevationMap(const std::map<int, rtabmap::Transform> & poses)
+{
+#if defined(WITH_GRID_MAP_ROS) and defined(RTABMAP_GRIDMAP)
+	UTimer time;
+	elevationMapUpdated_ = elevationMap_->update(poses);
+	elevationMapUpdateTime_ = time.ticks();
+#endif
+}
+
 pcl::PointCloud<pcl::PointXYZRGB>::Ptr subtractFiltering(
 		const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud,
 		const rtabmap::FlannIndex & substractCloudIndex,
@@ -774,15 +1459,307 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr subtractFiltering(
 	return output;
 }
 
-void MapsManager::publishMaps(
+void MapsManager::publishLocalMaps(
 		const std::map<int, rtabmap::Transform> & poses,
+		const ros::Time & stamp,
+		const std::string & mapFrameId,
+		const rtabmap::Transform & center)
+{
+	UTimer time;
+	float cx = center.x();
+	float cy = center.y();
+	float radius = localWindowRadius_;
+
+	// Only nodes close enough to have cells inside the window are used
+	float rangeMax = Parameters::defaultGridRangeMax();
+	Parameters::parse(parameters_, Parameters::kGridRangeMax(), rangeMax);
+	float nodeRadius = rangeMax > 0.0f?radius + rangeMax:radius*2.0f;
+	std::map<int, Transform> localPoses;
+	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
+	{
+		if(!iter->second.isNull() &&
+		   fabs(iter->second.x() - cx) <= nodeRadius &&
+		   fabs(iter->second.y() - cy) <= nodeRadius &&
+		   uContains(localMaps_.localGrids(), iter->first))
+		{
+			localPoses.insert(*iter);
+		}
+	}
+
+	if(cloudMapLocalPub_.getNumSubscribers())
+	{
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+		for(std::map<int, Transform>::const_iterator iter = localPoses.begin(); iter!=localPoses.end(); ++iter)
+		{
+			std::map<int, LocalGrid>::const_iterator jter = localMaps_.localGrids().find(iter->first);
+			for(int i=0; i<2; ++i)
+			{
+				const cv::Mat & cells = i==0?jter->second.groundCells:jter->second.obstacleCells;
+				if(cells.cols == 0)
+				{
+					continue;
+				}
+				pcl::PointCloud<pcl::PointXYZRGB>::Ptr transformed = util3d::laserScanToPointCloudRGB(
+						LaserScan::backwardCompatibility(cells), iter->second, i==0?0:255, i==0?255:0, 0);
+				cloud->reserve(cloud->size() + transformed->size());
+				for(unsigned int j=0; j<transformed->size(); ++j)
+				{
+					const pcl::PointXYZRGB & pt = transformed->at(j);
+					if(fabs(pt.x - cx) <= radius && fabs(pt.y - cy) <= radius)
+					{
+						cloud->push_back(pt);
+					}
+				}
+			}
+		}
+		if(cloudOutputVoxelized_ && cloud->size())
+		{
+			cloud = util3d::voxelize(cloud, occupancyGrid_->getCellSize());
+		}
+		sensor_msgs::PointCloud2::Ptr cloudMsg(new sensor_msgs::PointCloud2);
+		pcl::toROSMsg(*cloud, *cloudMsg);
+		cloudMsg->header.stamp = stamp;
+		cloudMsg->header.frame_id = mapFrameId;
+		cloudMapLocalPub_.publish(cloudMsg);
+	}
+
+	if(gridMapLocalPub_.getNumSubscribers())
+	{
+		// Separate grid of the local nodes, so that the cost doesn't depend on the global map size.
+		// Updated incrementally while the same nodes stay around the window. update() doesn't
+		// remove nodes not in the poses, so restart from scratch when a node left the window.
+		const std::map<int, Transform> & addedNodes = localOccupancyGrid_->addedNodes();
+		for(std::map<int, Transform>::const_iterator iter=addedNodes.begin(); iter!=addedNodes.end(); ++iter)
+		{
+			if(localPoses.find(iter->first) == localPoses.end())
+			{
+				localOccupancyGrid_->clear();
+				break;
+			}
+		}
+		localOccupancyGrid_->update(localPoses);
+		float xMin=0.0f, yMin=0.0f, gridCellSize = localOccupancyGrid_->getCellSize();
+		cv::Mat pixels = localOccupancyGrid_->getMap(xMin, yMin);
+		if(!pixels.empty())
+		{
+			int x0 = std::max(0, (int)std::floor((cx - radius - xMin)/gridCellSize));
+			int y0 = std::max(0, (int)std::floor((cy - radius - yMin)/gridCellSize));
+			int x1 = std::min(pixels.cols, (int)std::ceil((cx + radius - xMin)/gridCellSize));
+			int y1 = std::min(pixels.rows, (int)std::ceil((cy + radius - yMin)/gridCellSize));
+			if(x1 > x0 && y1 > y0)
+			{
+				cv::Mat window = pixels(cv::Range(y0, y1), cv::Range(x0, x1)).clone();
+
+				nav_msgs::OccupancyGrid map;
+				map.info.resolution = gridCellSize;
+				map.info.origin.position.x = xMin + x0*gridCellSize;
+				map.info.origin.position.y = yMin + y0*gridCellSize;
+				map.info.origin.position.z = 0.0;
+				map.info.origin.orientation.x = 0.0;
+				map.info.origin.orientation.y = 0.0;
+				map.info.origin.orientation.z = 0.0;
+				map.info.origin.orientation.w = 1.0;
+				map.info.width = window.cols;
+				map.info.height = window.rows;
+				map.data.resize(map.info.width * map.info.height);
+				memcpy(map.data.data(), window.data, map.info.width * map.info.height);
+				map.header.frame_id = mapFrameId;
+				map.header.stamp = stamp;
+				gridMapLocalPub_.publish(map);
+			}
+		}
+	}
+	ROS_DEBUG("Local maps published (%fs)", time.ticks());
+}
+
+void MapsManager::cloudMapTilesConnectCallback(const ros::SingleSubscriberPublisher & pub)
+{
+	// New subscribers don't have any tiles yet, send all the tiles already
+	// published only to them. Tiles not published yet are dirty and will be
+	// sent to everyone on next publication.
+	UScopeMutex lock(cloudMapTilesMutex_);
+	int sent = 0;
+	for(std::map<std::pair<int, int>, CloudMapTile>::const_iterator iter=cloudMapTiles_.begin(); iter!=cloudMapTiles_.end(); ++iter)
+	{
+		if(!iter->second.dirty)
+		{
+			pub.publish(createCloudMapTileMsg(iter->first, iter->second));
+			++sent;
+		}
+	}
+	ROS_DEBUG("Sent %d map tiles to new subscriber %s", sent, pub.getSubscriberName().c_str());
+}
+
+rtabmap_msgs::MapTilePtr MapsManager::createCloudMapTileMsg(
+		const std::pair<int, int> & key,
+		const CloudMapTile & tile) const
+{
+	rtabmap_msgs::MapTilePtr msg(new rtabmap_msgs::MapTile);
+	msg->header = cloudMapTilesHeader_;
+	msg->x = key.first;
+	msg->y = key.second;
+	msg->version = tile.version;
+	pcl::toROSMsg(tile.obstacles + tile.ground, msg->cloud);
+	msg->cloud.header = cloudMapTilesHeader_;
+	return msg;
+}
+
+void MapsManager::addCloudMapTilesPoints(
+		const pcl::PointCloud<pcl::PointXYZRGB> & cloud,
+		bool ground,
+		std::set<std::pair<int, int> > & touchedTiles)
+{
+	for(unsigned int i=0; i<cloud.size(); ++i)
+	{
+		const pcl::PointXYZRGB & pt = cloud.at(i);
+		std::pair<int, int> key((int)std::floor(pt.x/cloudMapTileSize_), (int)std::floor(pt.y/cloudMapTileSize_));
+		CloudMapTile & tile = cloudMapTiles_[key];
+		(ground?tile.ground:tile.obstacles).push_back(pt);
+		if(touchedTiles.insert(key).second && !tile.dirty)
+		{
+			tile.dirty = true;
+			++tile.version;
+		}
+	}
+}
+
+namespace {
+// Compare only the fields, padding bytes may be uninitialized
+bool sameCloudMapTilePoints(
+		const pcl::PointCloud<pcl::PointXYZRGB> & a,
+		const pcl::PointCloud<pcl::PointXYZRGB> & b)
+{
+	if(a.size() != b.size())
+	{
+		return false;
+	}
+	for(unsigned int i=0; i<a.size(); ++i)
+	{
+		const pcl::PointXYZRGB & pa = a.at(i);
+		const pcl::PointXYZRGB & pb = b.at(i);
+		if(pa.x != pb.x || pa.y != pb.y || pa.z != pb.z || pa.rgba != pb.rgba)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+}
+
+void MapsManager::rebuildCloudMapTiles()
+{
+	// Only done when the assembled clouds are regenerated (graph changed),
+	// tiles with the same content keep their version and are not sent again.
+	UScopeMutex lock(cloudMapTilesMutex_);
+	std::map<std::pair<int, int>, CloudMapTile> previousTiles;
+	previousTiles.swap(cloudMapTiles_);
+	std::set<std::pair<int, int> > touchedTiles;
+	addCloudMapTilesPoints(*assembledObstacles_, false, touchedTiles);
+	addCloudMapTilesPoints(*assembledGround_, true, touchedTiles);
+	for(std::map<std::pair<int, int>, CloudMapTile>::iterator iter=cloudMapTiles_.begin(); iter!=cloudMapTiles_.end(); ++iter)
+	{
+		std::map<std::pair<int, int>, CloudMapTile>::iterator jter = previousTiles.find(iter->first);
+		if(jter != previousTiles.end())
+		{
+			if(sameCloudMapTilePoints(iter->second.obstacles, jter->second.obstacles) &&
+			   sameCloudMapTilePoints(iter->second.ground, jter->second.ground))
+			{
+				iter->second.version = jter->second.version;
+				iter->second.dirty = jter->second.dirty;
+			}
+			else
+			{
+				iter->second.version = jter->second.version+1;
+			}
+			previousTiles.erase(jter);
+		}
+	}
+	cloudMapTilesRemoved_ = cloudMapTilesRemoved_ || !previousTiles.empty();
+	cloudMapTilesValid_ = true;
+}
+
+void MapsManager::publishCloudMapTiles(
 		const ros::Time & stamp,
 		const std::string & mapFrameId)
+{
+	UTimer time;
+	UScopeMutex lock(cloudMapTilesMutex_);
+	cloudMapTilesHeader_.stamp = stamp;
+	cloudMapTilesHeader_.frame_id = mapFrameId;
+	rtabmap_msgs::MapTileIndex index;
+	index.header = cloudMapTilesHeader_;
+	index.tile_size = cloudMapTileSize_;
+	index.x.reserve(cloudMapTiles_.size());
+	index.y.reserve(cloudMapTiles_.size());
+	index.versions.reserve(cloudMapTiles_.size());
+	int changed = 0;
+	size_t changedPoints = 0;
+	for(std::map<std::pair<int, int>, CloudMapTile>::iterator iter=cloudMapTiles_.begin(); iter!=cloudMapTiles_.end(); ++iter)
+	{
+		if(iter->second.dirty)
+		{
+			cloudMapTilesPub_.publish(createCloudMapTileMsg(iter->first, iter->second));
+			iter->second.dirty = false;
+			++changed;
+			changedPoints += iter->second.obstacles.size() + iter->second.ground.size();
+		}
+		index.x.push_back(iter->first.first);
+		index.y.push_back(iter->first.second);
+		index.versions.push_back(iter->second.version);
+	}
+
+	if(changed || cloudMapTilesRemoved_)
+	{
+		cloudMapTileIndexPub_.publish(index);
+	}
+	cloudMapTilesRemoved_ = false;
+	ROS_DEBUG("Published %d/%d map tiles (%ld points, %fs)", changed, (int)cloudMapTiles_.size(), changedPoints, time.ticks());
+}
+
+void MapsManager::publishMaps(
+		const std::map<int, rtabmap::Transform> & poses,
+		const ros::Time & stamp,
+		const std::string & mapFrameId,
+		const rtabmap::Transform & currentPose,
+		bool forceGlobalPublication)
 {
 	ROS_DEBUG("Publishing maps... poses=%d", (int)poses.size());
 
+	if(localWindowRadius_ > 0.0 &&
+	   (cloudMapLocalPub_.getNumSubscribers() || gridMapLocalPub_.getNumSubscribers()))
+	{
+		Transform center = currentPose;
+		if(center.isNull() && !poses.empty())
+		{
+			center = poses.find(0)!=poses.end()?poses.at(0):poses.rbegin()->second;
+		}
+		if(!center.isNull())
+		{
+			publishLocalMaps(poses, stamp, mapFrameId, center);
+		}
+	}
+
+	bool publishGlobal = forceGlobalPublication ||
+			globalPublishRate_ <= 0.0 ||
+			lastGlobalPublication_.isZero() ||
+			(ros::WallTime::now() - lastGlobalPublication_).toSec() >= 1.0/globalPublishRate_;
+	if(publishGlobal)
+	{
+		lastGlobalPublication_ = ros::WallTime::now();
+	}
+
+	if(cloudMapTilesValid_ && cloudMapTilesPub_.getNumSubscribers() == 0)
+	{
+		// don't maintain tiles without subscribers, next ones will receive all tiles
+		UScopeMutex lock(cloudMapTilesMutex_);
+		cloudMapTiles_.clear();
+		cloudMapTilesValid_ = false;
+		cloudMapTilesRemoved_ = false;
+	}
+
 	// publish maps
 	if(cloudMapPub_.getNumSubscribers() ||
+	   cloudMapTilesPub_.getNumSubscribers() ||
 	   scanMapPub_.getNumSubscribers() ||
 	   cloudObstaclesPub_.getNumSubscribers() ||
 	   cloudGroundPub_.getNumSubscribers())
@@ -811,9 +1788,11 @@ void MapsManager::publishMaps(
 		bool graphGroundOptimized = false;
 		bool graphObstacleOptimized = false;
 		bool updateGround = cloudMapPub_.getNumSubscribers() ||
+				   cloudMapTilesPub_.getNumSubscribers() ||
 				   scanMapPub_.getNumSubscribers() ||
 				   cloudGroundPub_.getNumSubscribers();
 		bool updateObstacles = cloudMapPub_.getNumSubscribers() ||
+				   cloudMapTilesPub_.getNumSubscribers() ||
 				   scanMapPub_.getNumSubscribers() ||
 				   cloudObstaclesPub_.getNumSubscribers();
 		bool graphGroundChanged = updateGround;
@@ -849,6 +1828,10 @@ void MapsManager::publishMaps(
 				}
 			}
 		}
+		bool updateTiles = cloudMapTileSize_ > 0.0 && cloudMapTilesPub_.getNumSubscribers();
+		bool rebuildTiles = updateTiles &&
+				(!cloudMapTilesValid_ || graphGroundOptimized || graphGroundChanged || graphObstacleOptimized || graphObstacleChanged);
+		std::set<std::pair<int, int> > touchedTiles;
 		int countObstacles = 0;
 		int countGrounds = 0;
 		int previousIndexedGroundSize = assembledGroundIndex_.indexedFeatures();
@@ -999,6 +1982,11 @@ void MapsManager::publishMaps(
 					if(subtractedCloud->size())
 					{
 						*assembledGround_+=*subtractedCloud;
+						if(updateTiles && !rebuildTiles)
+						{
+							UScopeMutex lock(cloudMapTilesMutex_);
+							addCloudMapTilesPoints(*subtractedCloud, true, touchedTiles);
+						}
 					}
 					++countGrounds;
 				}
@@ -1046,6 +2034,11 @@ void MapsManager::publishMaps(
 					if(subtractedCloud->size())
 					{
 						*assembledObstacles_+=*subtractedCloud;
+						if(updateTiles && !rebuildTiles)
+						{
+							UScopeMutex lock(cloudMapTilesMutex_);
+							addCloudMapTilesPoints(*subtractedCloud, false, touchedTiles);
+						}
 					}
 					++countObstacles;
 				}
@@ -1063,20 +2056,38 @@ void MapsManager::publishMaps(
 			{
 				assembledObstacles_ = util3d::voxelize(assembledObstacles_, occupancyGrid_->getCellSize());
 			}
+			UScopeMutex lock(cloudMapTilesMutex_);
+			for(std::set<std::pair<int, int> >::iterator iter=touchedTiles.begin(); iter!=touchedTiles.end(); ++iter)
+			{
+				CloudMapTile & tile = cloudMapTiles_.at(*iter);
+				if(tile.ground.size())
+				{
+					tile.ground = *util3d::voxelize(tile.ground.makeShared(), occupancyGrid_->getCellSize());
+				}
+				if(tile.obstacles.size())
+				{
+					tile.obstacles = *util3d::voxelize(tile.obstacles.makeShared(), occupancyGrid_->getCellSize());
+				}
+			}
+		}
+		if(rebuildTiles)
+		{
+			rebuildCloudMapTiles();
 		}
 
 		ROS_INFO("Assembled %d obstacle and %d ground clouds (%d points, %fs)",
 				countObstacles, countGrounds, (int)(assembledGround_->size() + assembledObstacles_->size()), time.ticks());
 
-		if( countGrounds > 0 ||
-			countObstacles > 0 ||
-			!latching_ ||
-			(assembledGround_->empty() && assembledObstacles_->empty()) ||
+		// Published later if global maps are throttled
+		globalCloudsPending_ = globalCloudsPending_ || countGrounds > 0 || countObstacles > 0;
+
+		if( (publishGlobal && (globalCloudsPending_ || !latching_ || (assembledGround_->empty() && assembledObstacles_->empty()))) ||
 			(cloudGroundPub_.getNumSubscribers() && !latched_.at(&cloudGroundPub_)) ||
 			(cloudObstaclesPub_.getNumSubscribers() && !latched_.at(&cloudObstaclesPub_)) ||
 			(cloudMapPub_.getNumSubscribers() && !latched_.at(&cloudMapPub_)) ||
 			(scanMapPub_.getNumSubscribers() && !latched_.at(&scanMapPub_)))
 		{
+			globalCloudsPending_ = false;
 			if(cloudGroundPub_.getNumSubscribers())
 			{
 				sensor_msgs::PointCloud2::Ptr cloudMsg(new sensor_msgs::PointCloud2);
@@ -1115,6 +2126,11 @@ void MapsManager::publishMaps(
 				}
 			}
 		}
+
+		if(updateTiles && publishGlobal)
+		{
+			publishCloudMapTiles(stamp, mapFrameId);
+		}
 	}
 	else if(mapCacheCleanup_)
 	{
@@ -1165,8 +2181,8 @@ void MapsManager::publishMaps(
 	}
 
 #if defined(WITH_OCTOMAP_MSGS) and defined(RTABMAP_OCTOMAP)
-	if( octomapUpdated_ ||
-		!latching_ ||
+	globalOctomapPending_ = globalOctomapPending_ || octomapUpdated_;
+	if( (publishGlobal && (globalOctomapPending_ || !latching_)) ||
 		(octoMapPubBin_.getNumSubscribers() && !latched_.at(&octoMapPubBin_)) ||
 		(octoMapPubFull_.getNumSubscribers() && !latched_.at(&octoMapPubFull_)) ||
 		(octoMapCloud_.getNumSubscribers() && !latched_.at(&octoMapCloud_)) ||
@@ -1176,6 +2192,7 @@ void MapsManager::publishMaps(
 		(octoMapEmptySpace_.getNumSubscribers() && !latched_.at(&octoMapEmptySpace_)) ||
 		(octoMapProj_.getNumSubscribers() && !latched_.at(&octoMapProj_)))
 	{
+		globalOctomapPending_ = false;
 		if(octoMapPubBin_.getNumSubscribers())
 		{
 			octomap_msgs::Octomap msg;
@@ -1205,7 +2222,26 @@ void MapsManager::publishMaps(
 			pcl::IndicesPtr frontierIndices(new std::vector<int>);
 			pcl::IndicesPtr emptyIndices(new std::vector<int>);
 			pcl::IndicesPtr groundIndices(new std::vector<int>);
-			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = octomap_->createCloud(octomapTreeDepth_, obstacleIndices.get(), emptyIndices.get(), groundIndices.get(), true, frontierIndices.get(),0);
+			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+			if(octomapIncrementalFrontier_ &&
+			   (octoMapFrontierCloud_.getNumSubscribers() || octoMapEmptySpace_.getNumSubscribers()))
+			{
+				updateOctomapDerivedClouds();
+			}
+			if(!octomapIncrementalFrontier_ ||
+			   octoMapCloud_.getNumSubscribers() ||
+			   octoMapObstacleCloud_.getNumSubscribers() ||
+			   octoMapGroundCloud_.getNumSubscribers())
+			{
+				cloud = octomap_->createCloud(
+						octomapTreeDepth_,
+						obstacleIndices.get(),
+						octomapIncrementalFrontier_?0:emptyIndices.get(),
+						groundIndices.get(),
+						true,
+						octomapIncrementalFrontier_?0:frontierIndices.get(),
+						0);
+			}
 
 			if(octoMapCloud_.getNumSubscribers())
 			{
@@ -1221,7 +2257,18 @@ void MapsManager::publishMaps(
 			if(octoMapFrontierCloud_.getNumSubscribers())
 			{
 				pcl::PointCloud<pcl::PointXYZRGB> cloudFrontier;
-				pcl::copyPointCloud(*cloud, *frontierIndices, cloudFrontier);
+				if(octomapIncrementalFrontier_)
+				{
+					cloudFrontier.reserve(octomapFrontierCells_.size());
+					for(std::map<unsigned long long, pcl::PointXYZRGB>::iterator iter=octomapFrontierCells_.begin(); iter!=octomapFrontierCells_.end(); ++iter)
+					{
+						cloudFrontier.push_back(iter->second);
+					}
+				}
+				else
+				{
+					pcl::copyPointCloud(*cloud, *frontierIndices, cloudFrontier);
+				}
 				pcl::toROSMsg(cloudFrontier, msg);
 				msg.header.frame_id = mapFrameId;
 				msg.header.stamp = stamp;
@@ -1251,7 +2298,18 @@ void MapsManager::publishMaps(
 			if(octoMapEmptySpace_.getNumSubscribers())
 			{
 				pcl::PointCloud<pcl::PointXYZRGB> cloudEmptySpace;
-				pcl::copyPointCloud(*cloud, *emptyIndices, cloudEmptySpace);
+				if(octomapIncrementalFrontier_)
+				{
+					cloudEmptySpace.reserve(octomapEmptyCells_.size());
+					for(std::map<unsigned long long, pcl::PointXYZRGB>::iterator iter=octomapEmptyCells_.begin(); iter!=octomapEmptyCells_.end(); ++iter)
+					{
+						cloudEmptySpace.push_back(iter->second);
+					}
+				}
+				else
+				{
+					pcl::copyPointCloud(*cloud, *emptyIndices, cloudEmptySpace);
+				}
 				pcl::toROSMsg(cloudEmptySpace, msg);
 				msg.header.frame_id = mapFrameId;
 				msg.header.stamp = stamp;
@@ -1320,6 +2378,9 @@ void MapsManager::publishMaps(
 					octomap_->octree()->memoryUsage()/1048576);
 		}
 		octomap_->clear();
+		octomapDerivedFullUpdate_ = true;
+		octomapFrontierCells_.clear();
+		octomapEmptyCells_.clear();
 	}
 
 	if(octoMapPubBin_.getNumSubscribers() == 0)
@@ -1356,12 +2417,13 @@ void MapsManager::publishMaps(
 	}
 #endif
 
-	if( gridUpdated_ ||
-		!latching_ ||
+	globalGridPending_ = globalGridPending_ || gridUpdated_;
+	if( (publishGlobal && (globalGridPending_ || !latching_)) ||
 		(gridMapPub_.getNumSubscribers() && !latched_.at(&gridMapPub_)) ||
 		(projMapPub_.getNumSubscribers() && !latched_.at(&projMapPub_)) ||
 		(gridProbMapPub_.getNumSubscribers() && !latched_.at(&gridProbMapPub_)))
 	{
+		globalGridPending_ = false;
 		if(projMapPub_.getNumSubscribers())
 		{
 			if(parameters_.find(Parameters::kGridSensor()) != parameters_.end() &&
@@ -1480,10 +2542,11 @@ void MapsManager::publishMaps(
 		latched_.at(&gridProbMapPub_) = false;
 	}
 #if defined(WITH_GRID_MAP_ROS) and defined(RTABMAP_GRIDMAP)
-	if( elevationMapUpdated_ ||
-		!latching_ ||
+	globalElevationMapPending_ = globalElevationMapPending_ || elevationMapUpdated_;
+	if( (publishGlobal && (globalElevationMapPending_ || !latching_)) ||
 		(elevationMapPub_.getNumSubscribers() && !latched_.at(&elevationMapPub_)))
 	{
+		globalElevationMapPending_ = false;
 		grid_map_msgs::GridMap msg;
 #if RTABMAP_VERSION_MAJOR>0 || (RTABMAP_VERSION_MAJOR==0 && RTABMAP_VERSION_MINOR>21) || (RTABMAP_VERSION_MAJOR==0 && RTABMAP_VERSION_MINOR==21 && RTABMAP_VERSION_PATCH>=8)
 		grid_map::GridMapRosConverter::toMessage(*elevationMap_->gridMap(), msg);
@@ -7,13 +7,18 @@
 
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/Imu.h>
+#include <nav_msgs/Odometry.h>
 
 #include <laser_geometry/laser_geometry.h>
 
 #include <pcl_ros/transforms.h>
+#include <pcl_conversions/pcl_conversions.h>
 
+#include <rtabmap/core/util3d.h>
 #include <rtabmap/core/util3d_transforms.h>
 #include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UMutex.h>
 #include <rtabmap_conversions/MsgConversion.h>
 
 namespace rtabmap_util
@@ -25,6 +30,8 @@ public:
 	LidarDeskewing() :
 		waitForTransformDuration_(0.01),
 		slerp_(false),
+		useImu_(false),
+		useOdom_(false),
 		tfListener_(0)
 	{
 	}
@@ -43,12 +50,27 @@ private:
 		pnh.param("fixed_frame_id", fixedFrameId_, fixedFrameId_);
 		pnh.param("wait_for_transform", waitForTransformDuration_, waitForTransformDuration_);
 		pnh.param("slerp", slerp_, slerp_);
+		pnh.param("use_imu", useImu_, useImu_);
+		pnh.param("use_odom", useOdom_, useOdom_);
 
 		NODELET_INFO("fixed_frame_id:  %s", fixedFrameId_.c_str());
 		NODELET_INFO("wait_for_transform:  %fs", waitForTransformDuration_);
 		NODELET_INFO("slerp:  %s", slerp_?"true":"false");
+		NODELET_INFO("use_imu:  %s", useImu_?"true":"false");
+		NODELET_INFO("use_odom:  %s", useOdom_?"true":"false");
 
-		if(fixedFrameId_.empty())
+		if(useImu_)
+		{
+			// IMU buffer is used instead of TF, so fixed_frame_id is not required
+			subImu_ = nh.subscribe("imu", 1000, &LidarDeskewing::callbackImu, this);
+			NODELET_INFO("Deskewing with IMU topic %s", subImu_.getTopic().c_str());
+			if(useOdom_)
+			{
+				subOdom_ = nh.subscribe("odom", 10, &LidarDeskewing::callbackOdom, this);
+				NODELET_INFO("Deskewing with odometry topic %s", subOdom_.getTopic().c_str());
+			}
+		}
+		else if(fixedFrameId_.empty())
 		{
 			NODELET_FATAL("fixed_frame_id parameter cannot be empty!");
 		}
@@ -59,8 +81,88 @@ private:
 		subCloud_ = nh.subscribe("input_cloud", 1, &LidarDeskewing::callbackCloud, this);
 	}
 
+	void callbackImu(const sensor_msgs::ImuConstPtr & msg)
+	{
+		// Kept in IMU frame, transform to lidar frame is applied when deskewing
+		double stamp = msg->header.stamp.toSec();
+		UScopeMutex m(imuMutex_);
+		imuFrameId_ = msg->header.frame_id;
+		imus_.insert(std::make_pair(stamp, rtabmap_conversions::imuFromROS(*msg)));
+		// keep only latest second, a scan should not be longer
+		while(imus_.begin()->first < stamp - 1.0)
+		{
+			imus_.erase(imus_.begin());
+		}
+	}
+
+	void callbackOdom(const nav_msgs::OdometryConstPtr & msg)
+	{
+		UScopeMutex m(imuMutex_);
+		odomFrameId_ = msg->child_frame_id;
+		odomVelocity_ = rtabmap::Transform(
+				msg->twist.twist.linear.x,
+				msg->twist.twist.linear.y,
+				msg->twist.twist.linear.z,
+				0, 0, 0);
+	}
+
+	bool deskewWithImu(const sensor_msgs::PointCloud2 & input, sensor_msgs::PointCloud2 & output)
+	{
+		std::map<double, rtabmap::IMU> imus;
+		std::string imuFrameId;
+		std::string odomFrameId;
+		rtabmap::Transform velocity;
+		{
+			UScopeMutex m(imuMutex_);
+			imus = imus_;
+			imuFrameId = imuFrameId_;
+			odomFrameId = odomFrameId_;
+			velocity = odomVelocity_;
+		}
+		if(imus.empty())
+		{
+			ROS_ERROR("No IMU received on %s yet!", subImu_.getTopic().c_str());
+			return false;
+		}
+
+		// IMU frame is used as base frame
+		rtabmap::Transform localTransform = rtabmap_conversions::getTransform(
+				imuFrameId, input.header.frame_id, input.header.stamp, *tfListener_, waitForTransformDuration_);
+		if(localTransform.isNull())
+		{
+			return false;
+		}
+		if(!velocity.isNull())
+		{
+			// Rotate linear velocity of odometry in IMU frame
+			rtabmap::Transform odomToImu = rtabmap_conversions::getTransform(
+					imuFrameId, odomFrameId, input.header.stamp, *tfListener_, waitForTransformDuration_);
+			if(odomToImu.isNull())
+			{
+				return false;
+			}
+			velocity = odomToImu.rotation() * velocity;
+		}
+		return rtabmap_conversions::deskew(input, output, imus, localTransform, velocity);
+	}
+
 	void callbackScan(const sensor_msgs::LaserScanConstPtr & msg)
 	{
+		if(useImu_)
+		{
+			sensor_msgs::PointCloud2 scanOut;
+			laser_geometry::LaserProjection projection;
+			projection.projectLaser(*msg, scanOut, -1.0, laser_geometry::channel_option::Intensity | laser_geometry::channel_option::Timestamp);
+			sensor_msgs::PointCloud2 scanOutDeskewed;
+			if(!deskewWithImu(scanOut, scanOutDeskewed))
+			{
+				ROS_ERROR("Cannot deskew scan with IMU at time %fs.", msg->header.stamp.toSec());
+				return;
+			}
+			pubScan_.publish(scanOutDeskewed);
+			return;
+		}
+
 		// make sure the frame of the laser is updated during the whole scan time
 		rtabmap::Transform tmpT = rtabmap_conversions::getMovingTransform(
 				msg->header.frame_id,
@@ -74,24 +176,26 @@ private:
 			return;
 		}
 
-		sensor_msgs::PointCloud2 scanOut;
-		laser_geometry::LaserProjection projection;
-		projection.transformLaserScanToPointCloud(fixedFrameId_, *msg, scanOut, *tfListener_);
-
+		// deskewed in laser frame at scan stamp
+		bool hasIntensity = !msg->intensities.empty() && msg->intensities.size() == msg->ranges.size();
+		rtabmap::LaserScan scan(
+				rtabmap_conversions::laserScanToPoints(*msg, false, tmpT),
+				0,
+				msg->range_max,
+				hasIntensity?rtabmap::LaserScan::kXYZI:rtabmap::LaserScan::kXYZ);
 		sensor_msgs::PointCloud2 scanOutDeskewed;
-		if(!pcl_ros::transformPointCloud(msg->header.frame_id, scanOut, scanOutDeskewed, *tfListener_))
-		{
-			ROS_ERROR("Cannot transform back projected scan from \"%s\" frame to \"%s\" frame at time %fs.",
-					fixedFrameId_.c_str(), msg->header.frame_id.c_str(), msg->header.stamp.toSec());
-			return;
-		}
+		pcl_conversions::moveFromPCL(*rtabmap::util3d::laserScanToPointCloud2(scan), scanOutDeskewed);
+		scanOutDeskewed.header = msg->header;
 		pubScan_.publish(scanOutDeskewed);
 	}
 
 	void callbackCloud(const sensor_msgs::PointCloud2ConstPtr & msg)
 	{
 		sensor_msgs::PointCloud2 msgDeskewed;
-		if(rtabmap_conversions::deskew(*msg, msgDeskewed, fixedFrameId_, *tfListener_, waitForTransformDuration_, slerp_))
+		bool deskewed = useImu_?
+				deskewWithImu(*msg, msgDeskewed):
+				rtabmap_conversions::deskew(*msg, msgDeskewed, fixedFrameId_, *tfListener_, waitForTransformDuration_, slerp_);
+		if(deskewed)
 		{
 			pubCloud_.publish(msgDeskewed);
 		}
@@ -109,9 +213,18 @@ private:
 	ros::Publisher pubCloud_;
 	ros::Subscriber subScan_;
 	ros::Subscriber subCloud_;
+	ros::Subscriber subImu_;
+	ros::Subscriber subOdom_;
 	std::string fixedFrameId_;
 	double waitForTransformDuration_;
 	bool slerp_;
+	bool useImu_;
+	bool useOdom_;
+	UMutex imuMutex_;
+	std::map<double, rtabmap::IMU> imus_;
+	std::string imuFrameId_;
+	std::string odomFrameId_;
+	rtabmap::Transform odomVelocity_;
 	tf::TransformListener * tfListener_;
 };
 
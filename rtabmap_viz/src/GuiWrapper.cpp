@@ -1158,7 +1158,15 @@ void GuiWrapper::commonSensorDataCallback(
 	{
 		lastOdomInfoUpdateTime_ = UTimer::now();
 
-		data = rtabmap_conversions::sensorDataFromROS(*sensorDataMsg);
+		if(sensorDataMsg->left.data.empty() && sensorDataMsg->right.data.empty() && sensorDataMsg->laser_scan.data.empty())
+		{
+			// compressed only, reference the message instead of copying the payloads
+			data = rtabmap_conversions::sensorDataFromROS(sensorDataMsg);
+		}
+		else
+		{
+			data = rtabmap_conversions::sensorDataFromROS(*sensorDataMsg);
+		}
 		data.uncompressData();
 
 		if(odomInfoMsg.get())